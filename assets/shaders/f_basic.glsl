@@ -4,20 +4,20 @@ out vec4 output_color;
 
 in vec3 Vertices;
 in vec3 Normals;
-in vec2 UVCoord;
+in vec3 UVCoord;
 in vec4 Colors;
 
+// Relative to the camera
 in vec3 FragPos;
 
-uniform vec3 cameraPos;
-
-uniform sampler2D mainTexture;
+uniform sampler2DArray mainTexture;
+uniform float alphaCutoff;
 
 void main()
 {
 	vec3 norm = normalize(Normals);
 
-	vec3 lightPos = cameraPos + (4.0f, 16.0f, 8.0f);
+	vec3 lightPos = vec3(4.0f, 16.0f, 8.0f);
 	vec3 lightDir = normalize(lightPos - FragPos);
 
 	vec3 ambient = vec3(0.1f);
@@ -26,4 +26,6 @@ void main()
 	vec3 result = vec3(1.0f);
 
 	output_color = vec4(result, 1.0f) * texture(mainTexture, UVCoord) * Colors;
+	if (output_color.a < alphaCutoff)
+		discard;
 }
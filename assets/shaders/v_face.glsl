@@ -0,0 +1,48 @@
+#version 330 core
+// One instance per packed face, expanded into a quad from gl_VertexID.
+// Layout matches MeshBuilder::PackFace.
+layout(location = 0) in uint aFace;
+
+out vec3 Vertices;
+out vec3 Normals;
+out vec3 UVCoord;
+out vec4 Colors;
+
+out vec3 FragPos;
+
+// Chunk origin relative to the camera, the view only rotates
+uniform vec3 chunkOffset;
+uniform mat4 view;
+uniform mat4 proj;
+
+uniform int faceScale;
+
+// corners, normals, quad, flippedQuad, aoCurve and FaceUV come from MeshBuilder::GetShaderSource
+
+void main()
+{
+	vec3 block = vec3(float(aFace & 31u), float((aFace >> 5u) & 31u), float((aFace >> 10u) & 31u));
+	int direction = int((aFace >> 15u) & 7u);
+	int layer = int((aFace >> 18u) & 63u);
+	int ao[4] = int[4](
+		int((aFace >> 24u) & 3u), int((aFace >> 26u) & 3u),
+		int((aFace >> 28u) & 3u), int((aFace >> 30u) & 3u));
+
+	// Split along the brighter diagonal, same as the vertex mesher
+	int corner = (ao[0] + ao[2] >= ao[1] + ao[3]) ? quad[gl_VertexID] : flippedQuad[gl_VertexID];
+
+	float scale = float(faceScale);
+	vec3 center = (block * 2.0f + 1.0f) * scale - 1.0f;
+	vec3 aPos = center + corners[direction * 4 + corner] * scale;
+
+	float light = aoCurve[ao[corner]];
+
+	Vertices = aPos;
+	Normals = normals[direction];
+	UVCoord = vec3(FaceUV(aPos, normals[direction]), float(layer));
+	Colors = vec4(light, light, light, 1.0f);
+
+	FragPos = aPos + chunkOffset;
+
+	gl_Position = proj * view * vec4(FragPos, 1.0f);
+}
@@ -0,0 +1,404 @@
+// Headless chunk meshing benchmark.
+// Meshes a set of canned chunks with every CPU mesher, no window or GL context needed.
+// With --gl it also draws them with each mesh format on a hidden window's context, offscreen.
+// Run from the repository root so the shaders and textures are found. To time Mesa's software
+// renderer, run with LIBGL_ALWAYS_SOFTWARE=1 (and GALLIUM_DRIVER=llvmpipe).
+//
+// usage: MeshBench [--iterations N] [--json file] [--gl] [--frames N]
+
+#include "Common.h"
+
+#include "Blocks.h"
+#include "ChunkBuilder.h"
+#include "FaceBuffer.h"
+#include "GLCapabilities.h"
+#include "MeshBuilder.h"
+#include "MeshCache.h"
+#include "Shader.h"
+#include "Texture.h"
+#include "ThreadPool.h"
+
+#include <glad/glad.h>
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <new>
+
+// Every heap allocation made by the process is counted
+static std::atomic<size_t> s_allocations = 0;
+
+void *operator new(size_t size)
+{
+	s_allocations++;
+	if (void *memory = std::malloc(size ? size : 1))
+		return memory;
+	throw std::bad_alloc();
+}
+void operator delete(void *memory) noexcept
+{
+	std::free(memory);
+}
+void operator delete(void *memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+struct Dataset
+{
+	const char *name;
+	// Block at a chunk local position, nullptr keeps the generated terrain
+	std::function<eBLOCKS(int x, int y, int z)> generator;
+};
+
+struct Mesher
+{
+	const char *name;
+	eMESH_FORMAT format;
+	int lod;
+	// Restored from a MeshCache instead of meshed
+	bool cached;
+	// Meshed in slabs across every core
+	bool parallel;
+};
+
+struct Result
+{
+	const char *dataset;
+	const char *mesher;
+	double microseconds;
+	size_t faces;
+	size_t bytes;
+	double allocations;
+	size_t cacheBytes;
+	// Pool workers besides the calling thread, and slabs the chunk was split into
+	int workers;
+	int slabs;
+};
+
+struct DrawResult
+{
+	const char *dataset;
+	const char *format;
+	double microseconds;
+	size_t faces;
+};
+
+static const int s_chunkSize = 32;
+static const int s_chunkHeight = 32;
+// Offscreen target the draw timings render to, the game's window size
+static const int s_drawWidth = 1280;
+static const int s_drawHeight = 720;
+
+static void FillChunk(ChunkBuilder &chunk, const Dataset &dataset)
+{
+	chunk.Create();
+	if (dataset.generator == nullptr)
+		return;
+	for (int x = 0; x < s_chunkSize; x++)
+	{
+		for (int y = 0; y < s_chunkHeight; y++)
+		{
+			for (int z = 0; z < s_chunkSize; z++)
+				chunk.SetBlock(x, y, z, dataset.generator(x, y, z));
+		}
+	}
+}
+
+// Times drawing every dataset's chunk once per frame in each mesh format, all passes, with the
+// frame finished before the clock stops. Returns false when there is no GL context to draw with.
+static bool RunDrawBenchmark(std::span<const Dataset> datasets, int frames, std::string &renderer, std::vector<DrawResult> &results)
+{
+	if (glfwInit() == GLFW_FALSE)
+		return false;
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	GLFWwindow *window = glfwCreateWindow(64, 64, "MeshBench", nullptr, nullptr);
+	if (window == nullptr)
+	{
+		glfwTerminate();
+		return false;
+	}
+	glfwMakeContextCurrent(window);
+	glfwSwapInterval(0);
+	if (gladLoadGLLoader((GLADloadproc)glfwGetProcAddress) == 0)
+	{
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return false;
+	}
+	GLCapabilities::Query();
+	renderer = (const char *)glGetString(GL_RENDERER);
+
+	{
+		// The hidden window's framebuffer may be tiny, draw into one the size of the game's
+		unsigned int framebuffer, renderbuffers[2];
+		glGenFramebuffers(1, &framebuffer);
+		glGenRenderbuffers(2, renderbuffers);
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, s_drawWidth, s_drawHeight);
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, s_drawWidth, s_drawHeight);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+		glViewport(0, 0, s_drawWidth, s_drawHeight);
+		glEnable(GL_DEPTH_TEST);
+		glDepthFunc(GL_LESS);
+		glEnable(GL_CULL_FACE);
+		glCullFace(GL_BACK);
+
+		Shader::SetSharedSource(MeshBuilder::GetShaderSource());
+		Shader basicShader("./assets/shaders/v_basic.glsl", "./assets/shaders/f_basic.glsl");
+		Shader faceShader("./assets/shaders/v_face.glsl", "./assets/shaders/f_basic.glsl");
+		Texture texture("./assets/textures/terrain.png", 16);
+		std::unique_ptr<Shader> pullShader;
+		std::unique_ptr<FaceBuffer> faceBuffer;
+		if (GLCapabilities::Get().storageBuffers)
+		{
+			pullShader = std::make_unique<Shader>("./assets/shaders/v_pull.glsl", "./assets/shaders/f_basic.glsl");
+			faceBuffer = std::make_unique<FaceBuffer>(1 << 20);
+		}
+
+		// The whole chunk in view, seen from above one side so every pass and most directions draw
+		const glm::mat4 proj = glm::perspective(glm::radians(90.0f), (float)s_drawWidth / (float)s_drawHeight, 0.1f, 1000.0f);
+		const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::normalize(glm::vec3(0.0f, -0.4f, -1.0f)), glm::vec3(0.0f, 1.0f, 0.0f));
+		const glm::vec3 chunkOffset = { -32.0f, -40.0f, -110.0f };
+		for (Shader *shader : { &basicShader, &faceShader, pullShader.get() })
+		{
+			if (shader == nullptr)
+				continue;
+			shader->Use();
+			shader->SetMatrix4("view", view);
+			shader->SetMatrix4("proj", proj);
+		}
+
+		struct Format
+		{
+			const char *name;
+			eMESH_FORMAT format;
+		};
+		const Format formats[] = {
+			{ "vertices", eMESH_FORMAT::VERTICES },
+			{ "packed_faces", eMESH_FORMAT::PACKED_FACES },
+			{ "pulled_faces", eMESH_FORMAT::PULLED_FACES },
+		};
+		auto drawFrame = [&](ChunkBuilder &chunk)
+			{
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				chunk.Draw(chunkOffset, eRENDER_PASS::SOLID);
+				chunk.Draw(chunkOffset, eRENDER_PASS::CUTOUT);
+				glEnable(GL_BLEND);
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+				glDepthMask(GL_FALSE);
+				chunk.Draw(chunkOffset, eRENDER_PASS::TRANSLUCENT);
+				glDepthMask(GL_TRUE);
+				glDisable(GL_BLEND);
+				if (faceBuffer)
+					faceBuffer->EndFrame();
+			};
+
+		for (const Dataset &dataset : datasets)
+		{
+			for (const Format &format : formats)
+			{
+				if (format.format == eMESH_FORMAT::PULLED_FACES && faceBuffer == nullptr)
+					continue;
+				ChunkBuilder chunk(&basicShader, &faceShader, pullShader.get(), &texture);
+				chunk.SetMeshFormat(format.format);
+				FillChunk(chunk, dataset);
+				chunk.Update(0.0f);
+
+				// Warm up, the first draws compile and upload on some drivers
+				drawFrame(chunk);
+				glFinish();
+
+				auto start = std::chrono::steady_clock::now();
+				for (int i = 0; i < frames; i++)
+					drawFrame(chunk);
+				glFinish();
+				auto end = std::chrono::steady_clock::now();
+
+				MeshBuilder &builder = MeshBuilder::GetThreadBuilder();
+				chunk.BuildMesh(builder, format.format, 0);
+				DrawResult result;
+				result.dataset = dataset.name;
+				result.format = format.name;
+				result.microseconds = std::chrono::duration<double, std::micro>(end - start).count() / frames;
+				result.faces = builder.GetFaceCount();
+				results.push_back(result);
+			}
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteRenderbuffers(2, renderbuffers);
+		glDeleteFramebuffers(1, &framebuffer);
+	}
+
+	glfwDestroyWindow(window);
+	glfwTerminate();
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	int iterations = 200;
+	int frames = 50;
+	bool draw = false;
+	const char *jsonPath = nullptr;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+			iterations = std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			frames = std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--gl") == 0)
+			draw = true;
+		else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+			jsonPath = argv[++i];
+	}
+
+	spdlog::set_level(spdlog::level::warn);
+
+	const Dataset datasets[] = {
+		{ "noisy_hills", nullptr },
+		{ "flat", [](int x, int y, int z)
+			{
+				if (y < 12) return eBLOCKS::STONE;
+				if (y < 15) return eBLOCKS::DIRT;
+				if (y == 15) return eBLOCKS::GRASS;
+				return eBLOCKS::NONE;
+			} },
+		// Every face of every block visible, the most faces a chunk can have
+		{ "checkerboard", [](int x, int y, int z) { return (x + y + z) % 2 == 0 ? eBLOCKS::STONE : eBLOCKS::NONE; } },
+		{ "all_solid", [](int x, int y, int z) { return eBLOCKS::STONE; } },
+		{ "all_air", [](int x, int y, int z) { return eBLOCKS::NONE; } },
+	};
+	const Mesher meshers[] = {
+		{ "vertices", eMESH_FORMAT::VERTICES, 0, false, false },
+		{ "packed_faces", eMESH_FORMAT::PACKED_FACES, 0, false, false },
+		{ "vertices_lod1", eMESH_FORMAT::VERTICES, 1, false, false },
+		{ "packed_faces_lod1", eMESH_FORMAT::PACKED_FACES, 1, false, false },
+		{ "vertices_lod2", eMESH_FORMAT::VERTICES, 2, false, false },
+		{ "packed_faces_lod2", eMESH_FORMAT::PACKED_FACES, 2, false, false },
+		{ "vertices_cached", eMESH_FORMAT::VERTICES, 0, true, false },
+		{ "packed_faces_cached", eMESH_FORMAT::PACKED_FACES, 0, true, false },
+		{ "vertices_parallel", eMESH_FORMAT::VERTICES, 0, false, true },
+		{ "packed_faces_parallel", eMESH_FORMAT::PACKED_FACES, 0, false, true },
+	};
+
+	std::vector<Result> results;
+	for (const Dataset &dataset : datasets)
+	{
+		ChunkBuilder chunk(nullptr, nullptr, nullptr, nullptr);
+		FillChunk(chunk, dataset);
+
+		for (const Mesher &mesher : meshers)
+		{
+			// Neither is passed to the chunk, ChunkBuilder finds them through MeshCache::Get() and ThreadPool::Get().
+			// Constructing them turns caching or parallel meshing on until they go out of scope.
+			// With a single core the pool has no workers and parallel rows mesh in one slab, like the serial ones.
+			std::unique_ptr<MeshCache> cache;
+			if (mesher.cached)
+				cache = std::make_unique<MeshCache>(64 * 1024 * 1024);
+			std::unique_ptr<ThreadPool> pool;
+			if (mesher.parallel)
+				pool = std::make_unique<ThreadPool>(std::max(1, (int)std::thread::hardware_concurrency()) - 1);
+
+			// Warm up the thread's scratch buffers (and fill the cache), so the timed runs measure steady state meshing
+			MeshBuilder &builder = MeshBuilder::GetThreadBuilder();
+			chunk.BuildMesh(builder, mesher.format, mesher.lod);
+
+			size_t allocations = s_allocations;
+			auto start = std::chrono::steady_clock::now();
+			for (int i = 0; i < iterations; i++)
+				chunk.BuildMesh(builder, mesher.format, mesher.lod);
+			auto end = std::chrono::steady_clock::now();
+			allocations = s_allocations - allocations;
+
+			Result result;
+			result.dataset = dataset.name;
+			result.mesher = mesher.name;
+			result.microseconds = std::chrono::duration<double, std::micro>(end - start).count() / iterations;
+			result.faces = builder.GetFaceCount();
+			result.bytes = builder.GetByteSize();
+			result.allocations = (double)allocations / iterations;
+			result.cacheBytes = cache ? cache->GetSize() : 0;
+			result.workers = pool ? pool->GetThreadCount() : 0;
+			result.slabs = chunk.GetSlabCount(mesher.lod);
+			results.push_back(result);
+		}
+	}
+
+	std::printf("%-14s %-22s %12s %10s %12s %12s %12s %8s %6s\n", "dataset", "mesher", "us/chunk", "faces", "bytes", "allocs", "cache bytes", "workers", "slabs");
+	for (const Result &result : results)
+	{
+		std::printf("%-14s %-22s %12.2f %10zu %12zu %12.2f %12zu %8d %6d\n",
+			result.dataset, result.mesher, result.microseconds, result.faces, result.bytes, result.allocations, result.cacheBytes,
+			result.workers, result.slabs);
+	}
+
+	std::string renderer;
+	std::vector<DrawResult> drawResults;
+	if (draw)
+	{
+		if (RunDrawBenchmark(datasets, frames, renderer, drawResults) == false)
+		{
+			std::fprintf(stderr, "Couldn't create a GL context to draw with\n");
+			return 1;
+		}
+		std::printf("\ndrawing %dx%d on %s, %d frames\n", s_drawWidth, s_drawHeight, renderer.c_str(), frames);
+		std::printf("%-14s %-22s %12s %10s\n", "dataset", "format", "us/frame", "faces");
+		for (const DrawResult &result : drawResults)
+			std::printf("%-14s %-22s %12.2f %10zu\n", result.dataset, result.format, result.microseconds, result.faces);
+	}
+
+	if (jsonPath)
+	{
+		std::ofstream file(jsonPath);
+		if (!file.is_open())
+		{
+			std::fprintf(stderr, "Failed to open %s\n", jsonPath);
+			return 1;
+		}
+		file << "{\n\t\"iterations\": " << iterations << ",\n\t\"results\": [\n";
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const Result &result = results[i];
+			file << "\t\t{ \"dataset\": \"" << result.dataset << "\", \"mesher\": \"" << result.mesher
+				<< "\", \"us_per_chunk\": " << result.microseconds
+				<< ", \"faces_per_chunk\": " << result.faces
+				<< ", \"bytes_per_chunk\": " << result.bytes
+				<< ", \"allocations_per_chunk\": " << result.allocations
+				<< ", \"cache_bytes_per_chunk\": " << result.cacheBytes
+				<< ", \"workers\": " << result.workers
+				<< ", \"slabs\": " << result.slabs
+				<< " }" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+		file << "\t]";
+		if (draw)
+		{
+			file << ",\n\t\"renderer\": \"" << renderer << "\",\n\t\"frames\": " << frames << ",\n\t\"draw_results\": [\n";
+			for (size_t i = 0; i < drawResults.size(); i++)
+			{
+				const DrawResult &result = drawResults[i];
+				file << "\t\t{ \"dataset\": \"" << result.dataset << "\", \"format\": \"" << result.format
+					<< "\", \"us_per_frame\": " << result.microseconds
+					<< ", \"faces\": " << result.faces
+					<< " }" << (i + 1 < drawResults.size() ? "," : "") << "\n";
+			}
+			file << "\t]";
+		}
+		file << "\n}\n";
+	}
+
+	return 0;
+}
@@ -6,3 +6,25 @@ Block::Block()
 { }
 Block::~Block()
 { }
+
+eRENDER_PASS GetRenderPass(eBLOCKS block)
+{
+	switch (block)
+	{
+		case eBLOCKS::GLASS:
+		case eBLOCKS::LEAVES:
+			return eRENDER_PASS::CUTOUT;
+		case eBLOCKS::WATER:
+			return eRENDER_PASS::TRANSLUCENT;
+		default:
+			return eRENDER_PASS::SOLID;
+	}
+}
+bool IsOpaque(eBLOCKS block)
+{
+	return block != eBLOCKS::NONE && GetRenderPass(block) == eRENDER_PASS::SOLID;
+}
+bool IsFaceHidden(eBLOCKS block, eBLOCKS neighbour)
+{
+	return IsOpaque(neighbour) || neighbour == block;
+}
@@ -6,9 +6,37 @@ enum class eBLOCKS
 	GRASS,
 	DIRT,
 	STONE,
+	GLASS,
+	WATER,
+	LEAVES,
 	BLOCKS_MAX
 };
 
+// Chunk submesh a block's faces are built into, drawn in this order
+enum class eRENDER_PASS
+{
+	SOLID = 0,
+	CUTOUT,
+	TRANSLUCENT,
+	PASS_MAX
+};
+
+enum class eDIRECTION
+{
+	X_NEGATIVE = 0,
+	X_POSITIVE,
+	Y_NEGATIVE,
+	Y_POSITIVE,
+	Z_NEGATIVE,
+	Z_POSITIVE,
+	DIRECTION_MAX
+};
+
+eRENDER_PASS GetRenderPass(eBLOCKS block);
+bool IsOpaque(eBLOCKS block);
+// Faces against opaque blocks or the same kind of block are never seen
+bool IsFaceHidden(eBLOCKS block, eBLOCKS neighbour);
+
 class Block
 {
 public:
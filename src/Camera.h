@@ -11,12 +11,14 @@ struct Camera
 
 	float pitch = 0.0f;
 	float yaw = -90.0f;
-	glm::vec3 position = { 0.0f, 0.0f, 4.0f };
+	// Double precision so it stays exact far from the origin, the world is drawn relative to it
+	glm::dvec3 position = { 0.0, 0.0, 4.0 };
 
 	glm::vec3 front = { 0.0f, 0.0f, -1.0f };
 	glm::vec3 up = { 0.0f, 1.0f, 0.0f };
 	glm::vec3 right;
 
+	// The view only rotates, positions are made relative to the camera before it
 	glm::mat4 view, proj;
 
 	void Update()
@@ -29,8 +31,7 @@ struct Camera
 		front = glm::normalize(direction);
 		right = glm::normalize(glm::cross(front, up));
 
-		//view = glm::mat4(1.0f);
-		view = glm::lookAt(position, position + front, up);
+		view = glm::lookAt(glm::vec3(0.0f), front, up);
 
 		proj = glm::perspective(glm::radians(fov), aspectRatio, nearPlane, farPlane);
 	}
@@ -2,27 +2,32 @@
 
 #include "Shader.h"
 #include "Texture.h"
+#include "MeshBuilder.h"
+#include "ChunkHalo.h"
+#include "FaceBuffer.h"
+#include "MemoryBudget.h"
+#include "MeshCache.h"
+#include "ThreadPool.h"
 
 #include <glad/glad.h>
 
+#include <algorithm>
+
 #define FNL_IMPL
 #include <FastNoiseLite.h>
 
-ChunkBuilder::ChunkBuilder(Shader *shader, Texture *texture)
+ChunkBuilder::ChunkBuilder(Shader *shader, Shader *faceShader, Shader *pullShader, Texture *texture)
 	: m_shader { shader }
+	, m_faceShader { faceShader }
+	, m_pullShader { pullShader }
 	, m_texture { texture }
 { }
 ChunkBuilder::~ChunkBuilder()
 { 
-	for (int i = 0; i < m_chunkSize; ++i)
-	{
-		for (int j = 0; j < m_chunkHeight; ++j)
-		{
-			delete[] m_blocks[i][j];
-		}
-		delete[] m_blocks[i];
-	}
-	delete[] m_blocks;
+	Unlink();
+
+	FreeBlocks();
+	MemoryBudget::Track(eMEMORY::BLOCKS, -(int64_t)m_packedBlocks.capacity());
 
 	spdlog::info("Destroyed Chunk.");
 }
@@ -31,29 +36,24 @@ void ChunkBuilder::Create()
 {
 	spdlog::info("Creating Chunk.");
 
-	m_blocks = new Block**[m_chunkSize];
-	for (int i = 0; i < m_chunkSize; i++)
-	{
-		m_blocks[i] = new Block*[m_chunkHeight];
-		for (int j = 0; j < m_chunkHeight; j++)
-		{
-			m_blocks[i][j] = new Block[m_chunkSize];
-		}
-	}
+	AllocateBlocks();
 
-	// Terrain
+	// Terrain, sampled at world block positions so it carries on across chunk borders
 	fnl_state noise = fnlCreateState();
 	noise.noise_type = FNL_NOISE_OPENSIMPLEX2;
+	const glm::ivec3 chunkCoord = GetChunkCoord();
 	for (int x = 0; x < m_chunkSize; x++)
 	{
-		for (int y = 0; y < m_chunkHeight; y++)
+		for (int z = 0; z < m_chunkSize; z++)
 		{
-			for (int z = 0; z < m_chunkSize; z++)
-			{
-				const float noiseScale = 0.5f;
-				float noiseMap = fnlGetNoise2D(&noise, m_chunkPos.x+x*noiseScale, m_chunkPos.z+z*noiseScale);
-				float height = (m_chunkHeight * 0.5f) * noiseMap;
+			const float noiseScale = 0.5f;
+			float worldX = (float)(chunkCoord.x * (int)m_chunkSize + x);
+			float worldZ = (float)(chunkCoord.z * (int)m_chunkSize + z);
+			float noiseMap = fnlGetNoise2D(&noise, worldX * noiseScale, worldZ * noiseScale);
+			float height = (m_chunkHeight * 0.5f) * noiseMap;
 
+			for (int y = 0; y < m_chunkHeight; y++)
+			{
 				m_blocks[x][y][z].SetDraw(true);
 				if (y <= m_chunkHeight * 0.5f + height)
 				{
@@ -63,6 +63,10 @@ void ChunkBuilder::Create()
 					if (y < (m_chunkHeight * 0.5f + height) - 4)
 						m_blocks[x][y][z].SetBlockType(eBLOCKS::STONE);
 				}
+				else if (y <= m_seaLevel)
+				{
+					m_blocks[x][y][z].SetBlockType(eBLOCKS::WATER);
+				}
 				else
 				{
 					m_blocks[x][y][z].SetDraw(false);
@@ -87,18 +91,122 @@ void ChunkBuilder::Create()
 			}
 		}
 	}
+
+	// Meshed on the next update
+	m_meshDirty[m_lod] = true;
+}
+
+void ChunkBuilder::AllocateBlocks()
+{
+	m_blocks = new Block**[m_chunkSize];
+	for (int i = 0; i < m_chunkSize; i++)
+	{
+		m_blocks[i] = new Block*[m_chunkHeight];
+		for (int j = 0; j < m_chunkHeight; j++)
+		{
+			m_blocks[i][j] = new Block[m_chunkSize];
+		}
+	}
+	MemoryBudget::Track(eMEMORY::BLOCKS, GetBlocksSize());
+}
+void ChunkBuilder::FreeBlocks()
+{
+	if (m_blocks == nullptr)
+		return;
+	for (int i = 0; i < m_chunkSize; ++i)
+	{
+		for (int j = 0; j < m_chunkHeight; ++j)
+		{
+			delete[] m_blocks[i][j];
+		}
+		delete[] m_blocks[i];
+	}
+	delete[] m_blocks;
+	m_blocks = nullptr;
+	MemoryBudget::Track(eMEMORY::BLOCKS, -(int64_t)GetBlocksSize());
+}
+
+void ChunkBuilder::CompressBlocks()
+{
+	if (m_blocks == nullptr)
+		return;
+
+	// Terrain is mostly long columns of the same block, runs are capped at 255 to fit a byte
+	m_packedBlocks.clear();
+	eBLOCKS run = eBLOCKS::BLOCKS_MAX;
+	for (int x = 0; x < m_chunkSize; x++)
+	{
+		for (int y = 0; y < m_chunkHeight; y++)
+		{
+			for (int z = 0; z < m_chunkSize; z++)
+			{
+				eBLOCKS block = GetBlock(x, y, z);
+				if (block == run && m_packedBlocks.back() < 255)
+				{
+					m_packedBlocks.back()++;
+					continue;
+				}
+				m_packedBlocks.push_back((unsigned char)block);
+				m_packedBlocks.push_back(1);
+				run = block;
+			}
+		}
+	}
+	m_packedBlocks.shrink_to_fit();
+	MemoryBudget::Track(eMEMORY::BLOCKS, m_packedBlocks.capacity());
+	FreeBlocks();
+}
+size_t ChunkBuilder::GetMemoryUsage()
+{
+	size_t usage = (m_blocks ? GetBlocksSize() : 0) + m_packedBlocks.capacity();
+	for (ChunkMesh &mesh : m_sectionMeshes)
+		usage += mesh.GetMemoryUsage();
+	for (ChunkMesh &mesh : m_meshes)
+		usage += mesh.GetMemoryUsage();
+	return usage;
+}
+
+void ChunkBuilder::DecompressBlocks()
+{
+	if (m_blocks != nullptr)
+		return;
+
+	AllocateBlocks();
+	size_t packed = 0;
+	int remaining = 0;
+	eBLOCKS block = eBLOCKS::NONE;
+	for (int x = 0; x < m_chunkSize; x++)
+	{
+		for (int y = 0; y < m_chunkHeight; y++)
+		{
+			for (int z = 0; z < m_chunkSize; z++)
+			{
+				if (remaining == 0)
+				{
+					block = (eBLOCKS)m_packedBlocks[packed];
+					remaining = m_packedBlocks[packed + 1];
+					packed += 2;
+				}
+				m_blocks[x][y][z].SetBlockType(block);
+				m_blocks[x][y][z].SetDraw(block != eBLOCKS::NONE);
+				remaining--;
+			}
+		}
+	}
+	MemoryBudget::Track(eMEMORY::BLOCKS, -(int64_t)m_packedBlocks.capacity());
+	m_packedBlocks = std::vector<unsigned char>();
 }
 
-void ChunkBuilder::CreateCube(float x, float y, float z,
+void ChunkBuilder::CreateCube(MeshBuilder &builder, const ChunkHalo &halo, int x, int y, int z, int scale,
 							bool xNegativeVisible, bool xPositiveVisible,
 							bool yNegativeVisible, bool yPositiveVisible,
 							bool zNegativeVisible, bool zPositiveVisible)
 {
-	// Vertex Points
-	const float blockSize = 1.0f;
-	float xPos = x * 2.0f;
-	float yPos = y * 2.0f;
-	float zPos = z * 2.0f;
+	// Vertex Points, a block at scale covers scale^3 full size blocks
+	const float blockSize = (float)scale;
+	float xPos = (x * 2.0f + 1.0f) * scale - 1.0f;
+	float yPos = (y * 2.0f + 1.0f) * scale - 1.0f;
+	float zPos = (z * 2.0f + 1.0f) * scale - 1.0f;
 	glm::vec3 p1 = { xPos - blockSize, yPos - blockSize, zPos + blockSize };
 	glm::vec3 p2 = { xPos + blockSize, yPos - blockSize, zPos + blockSize };
 	glm::vec3 p3 = { xPos + blockSize, yPos + blockSize, zPos + blockSize };
@@ -108,15 +216,8 @@ void ChunkBuilder::CreateCube(float x, float y, float z,
 	glm::vec3 p7 = { xPos - blockSize, yPos + blockSize, zPos - blockSize };
 	glm::vec3 p8 = { xPos + blockSize, yPos + blockSize, zPos - blockSize };
 
-	// UV Coordinates
-	const float uvOff = 1.0f/8.0f;
-	glm::vec2 uv1, uv2, uv3, uv4;
-
-	glm::vec3 n1; // Normals
-	float r, g, b, a; // Colors
-
 	// Set Block Texture Sides
-	eBLOCKS blockType = m_blocks[(int)x][(int)y][(int)z].GetBlockType();
+	eBLOCKS blockType = halo.Get(x, y, z);
 	int frontIndex, backIndex, rightIndex, leftIndex, topIndex, bottomIndex;
 	switch (blockType)
 	{
@@ -147,6 +248,33 @@ void ChunkBuilder::CreateCube(float x, float y, float z,
 			topIndex		= 3;
 			bottomIndex		= 3;
 		} break;
+		case eBLOCKS::GLASS:
+		{
+			frontIndex		= 4;
+			backIndex		= 4;
+			rightIndex		= 4;
+			leftIndex		= 4;
+			topIndex		= 4;
+			bottomIndex		= 4;
+		} break;
+		case eBLOCKS::WATER:
+		{
+			frontIndex		= 5;
+			backIndex		= 5;
+			rightIndex		= 5;
+			leftIndex		= 5;
+			topIndex		= 5;
+			bottomIndex		= 5;
+		} break;
+		case eBLOCKS::LEAVES:
+		{
+			frontIndex		= 6;
+			backIndex		= 6;
+			rightIndex		= 6;
+			leftIndex		= 6;
+			topIndex		= 6;
+			bottomIndex		= 6;
+		} break;
 		default:
 		{
 			frontIndex		= 0;
@@ -159,234 +287,585 @@ void ChunkBuilder::CreateCube(float x, float y, float z,
 	}
 
 	// Create Mesh
-	unsigned int v1, v2, v3, v4, v5, v6, v7, v8;
+	eRENDER_PASS pass = GetRenderPass(blockType);
+	glm::ivec3 block = { x, y, z };
 	// Front
 	if (zPositiveVisible == false)
-	{
-		r = 1.0f; g = 1.0f; b = 1.0f; a = 1.0f;
-		n1 = { 0.0f, 0.0f, 1.0f };
-		uv1 = { (float)(frontIndex%8)/8, uvOff+(float)(frontIndex/8)/8 };
-		uv2 = { uvOff+(float)(frontIndex%8)/8, uvOff+(float)(frontIndex/8)/8 };
-		uv3 = { uvOff+(float)(frontIndex%8)/8, (float)(frontIndex/8)/8 };
-		uv4 = { (float)(frontIndex%8)/8, (float)(frontIndex/8)/8 };
-		v1 = AddVertex(p1, n1, uv1, r, g, b, a);
-		v2 = AddVertex(p2, n1, uv2, r, g, b, a);
-		v3 = AddVertex(p3, n1, uv3, r, g, b, a);
-		v4 = AddVertex(p4, n1, uv4, r, g, b, a);
-		AddTriangle(v1, v2, v3); // Tri 1
-		AddTriangle(v1, v3, v4); // Tri 2
-	}
+		AddFace(builder, halo, pass, block, p1, p2, p3, p4, { 0.0f, 0.0f, 1.0f }, frontIndex);
 	// Back
 	if (zNegativeVisible == false)
-	{
-		r = 1.0f; g = 1.0f; b = 1.0f; a = 1.0f;
-		n1 = { 0.0f, 0.0f, -1.0f };
-		uv1 = { (float)(backIndex%8)/8, uvOff+(float)(backIndex/8)/8 };
-		uv2 = { uvOff+(float)(backIndex%8)/8, uvOff+(float)(backIndex/8)/8 };
-		uv3 = { uvOff+(float)(backIndex%8)/8, (float)(backIndex/8)/8 };
-		uv4 = { (float)(backIndex%8)/8, (float)(backIndex/8)/8 };
-		v5 = AddVertex(p5, n1, uv1, r, g, b, a);
-		v6 = AddVertex(p6, n1, uv2, r, g, b, a);
-		v7 = AddVertex(p7, n1, uv3, r, g, b, a);
-		v8 = AddVertex(p8, n1, uv4, r, g, b, a);
-		AddTriangle(v5, v6, v7); // Tri 1
-		AddTriangle(v5, v7, v8); // Tri 2
-	}
+		AddFace(builder, halo, pass, block, p5, p6, p7, p8, { 0.0f, 0.0f, -1.0f }, backIndex);
 	// Right
 	if (xPositiveVisible == false)
-	{
-		r = 1.0f; g = 1.0f; b = 1.0f; a = 1.0f;
-		n1 ={ 1.0f, 0.0f, 0.0f };
-		uv1 ={ (float)(rightIndex%8)/8, uvOff+(float)(rightIndex/8)/8 };
-		uv2 ={ uvOff+(float)(rightIndex%8)/8, uvOff+(float)(rightIndex/8)/8 };
-		uv3 ={ uvOff+(float)(rightIndex%8)/8, (float)(rightIndex/8)/8 };
-		uv4 ={ (float)(rightIndex%8)/8, (float)(rightIndex/8)/8 };
-		v2 = AddVertex(p2, n1, uv1, r, g, b, a);
-		v5 = AddVertex(p5, n1, uv2, r, g, b, a);
-		v8 = AddVertex(p8, n1, uv3, r, g, b, a);
-		v3 = AddVertex(p3, n1, uv4, r, g, b, a);
-		AddTriangle(v2, v5, v8); // Tri 1
-		AddTriangle(v2, v8, v3); // Tri 2
-	}
+		AddFace(builder, halo, pass, block, p2, p5, p8, p3, { 1.0f, 0.0f, 0.0f }, rightIndex);
 	// Left
 	if (xNegativeVisible == false)
-	{
-		r = 1.0f; g = 1.0f; b = 1.0f; a = 1.0f;
-		n1 ={ -1.0f, 0.0f, 0.0f };
-		uv1 ={ (float)(leftIndex%8)/8, uvOff+(float)(leftIndex/8)/8 };
-		uv2 ={ uvOff+(float)(leftIndex%8)/8, uvOff+(float)(leftIndex/8)/8 };
-		uv3 ={ uvOff+(float)(leftIndex%8)/8, (float)(leftIndex/8)/8 };
-		uv4 ={ (float)(leftIndex%8)/8, (float)(leftIndex/8)/8 };
-		v6 = AddVertex(p6, n1, uv1, r, g, b, a);
-		v1 = AddVertex(p1, n1, uv2, r, g, b, a);
-		v4 = AddVertex(p4, n1, uv3, r, g, b, a);
-		v7 = AddVertex(p7, n1, uv4, r, g, b, a);
-		AddTriangle(v6, v1, v4); // Tri 1
-		AddTriangle(v6, v4, v7); // Tri 2
-	}
+		AddFace(builder, halo, pass, block, p6, p1, p4, p7, { -1.0f, 0.0f, 0.0f }, leftIndex);
 	// Top
 	if (yPositiveVisible == false)
-	{
-		r = 1.0f; g = 1.0f; b = 1.0f; a = 1.0f;
-		n1 ={ 0.0f, 1.0f, 0.0f };
-		uv1 ={ (float)(topIndex%8)/8, uvOff+(float)(topIndex/8)/8 };
-		uv2 ={ uvOff+(float)(topIndex%8)/8, uvOff+(float)(topIndex/8)/8 };
-		uv3 ={ uvOff+(float)(topIndex%8)/8, (float)(topIndex/8)/8 };
-		uv4 ={ (float)(topIndex%8)/8, (float)(topIndex/8)/8 };
-		v4 = AddVertex(p4, n1, uv1, r, g, b, a);
-		v3 = AddVertex(p3, n1, uv2, r, g, b, a);
-		v8 = AddVertex(p8, n1, uv3, r, g, b, a);
-		v7 = AddVertex(p7, n1, uv4, r, g, b, a);
-		AddTriangle(v4, v3, v8); // Tri 1
-		AddTriangle(v4, v8, v7); // Tri 2
-	}
+		AddFace(builder, halo, pass, block, p4, p3, p8, p7, { 0.0f, 1.0f, 0.0f }, topIndex);
 	// Bottom
 	if (yNegativeVisible == false)
+		AddFace(builder, halo, pass, block, p6, p5, p2, p1, { 0.0f, -1.0f, 0.0f }, bottomIndex);
+}
+void ChunkBuilder::AddFace(MeshBuilder &builder, const ChunkHalo &halo, eRENDER_PASS pass, glm::ivec3 block,
+						glm::vec3 p1, glm::vec3 p2, glm::vec3 p3, glm::vec3 p4,
+						glm::vec3 normal, int textureIndex)
+{
+	eDIRECTION direction;
+	if (normal.x != 0.0f)
+		direction = normal.x < 0.0f ? eDIRECTION::X_NEGATIVE : eDIRECTION::X_POSITIVE;
+	else if (normal.y != 0.0f)
+		direction = normal.y < 0.0f ? eDIRECTION::Y_NEGATIVE : eDIRECTION::Y_POSITIVE;
+	else
+		direction = normal.z < 0.0f ? eDIRECTION::Z_NEGATIVE : eDIRECTION::Z_POSITIVE;
+
+	// Ambient Occlusion
+	glm::vec3 center = (p1 + p2 + p3 + p4) * 0.25f;
+	glm::ivec3 n = { (int)normal.x, (int)normal.y, (int)normal.z };
+	int ao1 = VertexAO(halo, block, n, p1 - center);
+	int ao2 = VertexAO(halo, block, n, p2 - center);
+	int ao3 = VertexAO(halo, block, n, p3 - center);
+	int ao4 = VertexAO(halo, block, n, p4 - center);
+
+	// Expanded into vertices by the builder, or by the vertex shader for packed formats
+	builder.AddFace(pass, direction, MeshBuilder::PackFace(block, direction, textureIndex, ao1, ao2, ao3, ao4));
+}
+
+int ChunkBuilder::VertexAO(const ChunkHalo &halo, glm::ivec3 block, glm::ivec3 normal, glm::vec3 corner)
+{
+	// The two blocks beside the vertex and the one diagonal to it, in the layer the face looks into
+	glm::ivec3 layer = block + normal;
+	glm::ivec3 side1 = { 0, 0, 0 };
+	glm::ivec3 side2 = { 0, 0, 0 };
+	bool first = true;
+	for (int i = 0; i < 3; i++)
 	{
-		r = 1.0f; g = 1.0f; b = 1.0f; a = 1.0f;
-		n1 ={ 0.0f, -1.0f, 0.0f };
-		uv1 ={ (float)(bottomIndex%8)/8, uvOff+(float)(bottomIndex/8)/8 };
-		uv2 ={ uvOff+(float)(bottomIndex%8)/8, uvOff+(float)(bottomIndex/8)/8 };
-		uv3 ={ uvOff+(float)(bottomIndex%8)/8, (float)(bottomIndex/8)/8 };
-		uv4 ={ (float)(bottomIndex%8)/8, (float)(bottomIndex/8)/8 };
-		v6 = AddVertex(p6, n1, uv1, r, g, b, a);
-		v5 = AddVertex(p5, n1, uv2, r, g, b, a);
-		v2 = AddVertex(p2, n1, uv3, r, g, b, a);
-		v1 = AddVertex(p1, n1, uv4, r, g, b, a);
-		AddTriangle(v6, v5, v2); // Tri 1
-		AddTriangle(v6, v2, v1); // Tri 2
+		if (normal[i] != 0)
+			continue;
+		int offset = corner[i] > 0.0f ? 1 : -1;
+		if (first)
+			side1[i] = offset;
+		else
+			side2[i] = offset;
+		first = false;
 	}
 
+	bool s1 = halo.IsOpaque(layer.x + side1.x, layer.y + side1.y, layer.z + side1.z);
+	bool s2 = halo.IsOpaque(layer.x + side2.x, layer.y + side2.y, layer.z + side2.z);
+	if (s1 && s2)
+		return 0;
+	bool c = halo.IsOpaque(layer.x + side1.x + side2.x, layer.y + side1.y + side2.y, layer.z + side1.z + side2.z);
+	return 3 - ((int)s1 + (int)s2 + (int)c);
 }
-void ChunkBuilder::CreateMesh()
+void ChunkBuilder::CreateMesh(int lod)
 {
 	spdlog::info("Creating Chunk Mesh.");
 
-	for (int x = 0; x < m_chunkSize; x++)
+	if (lod == 0)
 	{
-		for (int y = 0; y < m_chunkHeight; y++)
+		m_sectionDirty = (1u << CHUNK_SECTION_COUNT) - 1;
+		CreateSectionMeshes();
+		return;
+	}
+
+	MeshBuilder &builder = MeshBuilder::GetThreadBuilder();
+	BuildMesh(builder, m_meshFormat, lod, &m_meshes[lod]);
+
+	m_meshes[lod].Upload(builder);
+	m_hasMesh[lod] = true;
+	m_meshDirty[lod] = false;
+}
+
+void ChunkBuilder::BuildMesh(MeshBuilder &builder, eMESH_FORMAT format, int lod, ChunkMesh *target)
+{
+	const int scale = 1 << lod;
+	ChunkHalo &halo = ChunkHalo::GetThreadHalo();
+	CopyHalo(halo);
+
+	// Coarser levels mesh a downsampled copy
+	ChunkHalo *meshHalo = &halo;
+	if (lod > 0)
+	{
+		meshHalo = &ChunkHalo::GetThreadLodHalo();
+		meshHalo->Downsample(halo, scale);
+	}
+
+	// Whole chunk meshes at full resolution are only built outside the game, they have no section
+	BuildRegion(builder, *meshHalo, format, lod, lod > 0 ? 0 : -1, 0, meshHalo->GetHeight(), target);
+}
+
+void ChunkBuilder::BuildRegion(MeshBuilder &builder, const ChunkHalo &halo, eMESH_FORMAT format, int lod, int section, int yBegin, int yEnd, ChunkMesh *target)
+{
+	MeshCache *cache = MeshCache::Get();
+	MeshCacheKey key = { GetChunkCoord(), lod, section };
+	uint64_t hash = 0;
+	if (cache)
+	{
+		hash = halo.Hash(yBegin, yEnd);
+		if (cache->Restore(key, hash, builder, format, 1 << lod, target))
+			return;
+	}
+
+	// Regions are split along x into slabs that are counted and meshed in parallel. Each slab
+	// writes its own range of every output, and the mesher walks x outermost, so the slabs join up
+	// in the same order a single thread emits faces without being copied together.
+	ThreadPool *pool = ThreadPool::Get();
+	const int size = halo.GetSize();
+	const int slabCount = GetSlabCount(lod);
+	auto slabX = [&](int slab) { return size * slab / slabCount; };
+
+	MeshCounts slabCounts[CHUNK_MAX_SLABS];
+	if (slabCount == 1)
+		CountFaces(halo, 0, size, yBegin, yEnd, slabCounts[0]);
+	else
+		pool->ParallelFor(slabCount, [&](int slab) { CountFaces(halo, slabX(slab), slabX(slab + 1), yBegin, yEnd, slabCounts[slab]); });
+
+	// Where each slab starts in every bucket
+	MeshCounts counts;
+	MeshCounts slabOffsets[CHUNK_MAX_SLABS];
+	for (int slab = 0; slab < slabCount; slab++)
+	{
+		slabOffsets[slab] = counts;
+		for (int pass = 0; pass < (int)eRENDER_PASS::PASS_MAX; pass++)
 		{
-			for (int z = 0; z < m_chunkSize; z++)
+			for (int i = 0; i < (int)eDIRECTION::DIRECTION_MAX; i++)
+				counts.faces[pass][i] += slabCounts[slab].faces[pass][i];
+		}
+	}
+
+	// The cache reads the faces back after meshing, which mapped GPU memory is far too slow for,
+	// so meshes built straight into it are only stored when the cache asks for them
+	unsigned int *output = nullptr;
+	if (target && (cache == nullptr || cache->IsStoringMappedMeshes() == false))
+		output = target->MapFaces(counts, format);
+	builder.Begin(counts, format, 1 << lod, output);
+	if (slabCount == 1)
+		MeshRegion(builder, halo, 1 << lod, 0, size, yBegin, yEnd);
+	else
+	{
+		// The calling thread's, the jobs run on other threads
+		static thread_local MeshBuilder s_slabBuilders[CHUNK_MAX_SLABS];
+		MeshBuilder *slabBuilders = s_slabBuilders;
+		pool->ParallelFor(slabCount, [&](int slab)
+			{
+				slabBuilders[slab].BeginSlab(builder, slabOffsets[slab]);
+				MeshRegion(slabBuilders[slab], halo, 1 << lod, slabX(slab), slabX(slab + 1), yBegin, yEnd);
+			});
+		builder.EndSlabs();
+	}
+
+	if (cache && output == nullptr)
+		cache->Store(key, hash, builder);
+}
+
+int ChunkBuilder::GetSlabCount(int lod)
+{
+	ThreadPool *pool = ThreadPool::Get();
+	if (pool == nullptr)
+		return 1;
+	const int size = (int)m_chunkSize >> lod;
+	return std::clamp(std::min(pool->GetThreadCount() + 1, size / m_minSlabWidth), 1, CHUNK_MAX_SLABS);
+}
+
+void ChunkBuilder::CreateSectionMeshes()
+{
+	ChunkHalo &halo = ChunkHalo::GetThreadHalo();
+	CopyHalo(halo);
+
+	const int sectionHeight = m_chunkHeight / CHUNK_SECTION_COUNT;
+	for (int section = 0; section < CHUNK_SECTION_COUNT; section++)
+	{
+		if ((m_sectionDirty & (1u << section)) == 0)
+			continue;
+
+		int yBegin = section * sectionHeight;
+		int yEnd = yBegin + sectionHeight;
+
+		MeshBuilder &builder = MeshBuilder::GetThreadBuilder();
+		BuildRegion(builder, halo, m_meshFormat, 0, section, yBegin, yEnd, &m_sectionMeshes[section]);
+		m_sectionMeshes[section].Upload(builder);
+	}
+
+	m_sectionDirty = 0;
+	m_hasMesh[0] = true;
+	m_meshDirty[0] = false;
+}
+
+void ChunkBuilder::MeshRegion(MeshBuilder &builder, const ChunkHalo &halo, int scale, int xBegin, int xEnd, int yBegin, int yEnd)
+{
+	for (int x = xBegin; x < xEnd; x++)
+	{
+		for (int y = yBegin; y < yEnd; y++)
+		{
+			for (int z = 0; z < halo.GetSize(); z++)
 			{
 				// Skip if not drawing block
-				if (m_blocks[x][y][z].IsDrawing() == false)
+				if (halo.IsSolid(x, y, z) == false)
 					continue;
 				// Check Neighbors
-				bool nXNegative = false;
-				if (x > 0)
-					nXNegative = m_blocks[x-1][y][z].IsDrawing();
-				bool nXPositive = false;
-				if (x < m_chunkSize-1)
-					nXPositive = m_blocks[x+1][y][z].IsDrawing();
-				bool nYNegative = false;
-				if (y > 0)
-					nYNegative = m_blocks[x][y-1][z].IsDrawing();
-				bool nYPositive = false;
-				if (y < m_chunkHeight-1)
-					nYPositive = m_blocks[x][y+1][z].IsDrawing();
-				bool nZNegative = false;
-				if (z > 0)
-					nZNegative = m_blocks[x][y][z-1].IsDrawing();
-				bool nZPositive = false;
-				if (z < m_chunkSize-1)
-					nZPositive = m_blocks[x][y][z+1].IsDrawing();
+				eBLOCKS block = halo.Get(x, y, z);
+				bool nXNegative = IsFaceHidden(block, halo.Get(x-1, y, z));
+				bool nXPositive = IsFaceHidden(block, halo.Get(x+1, y, z));
+				bool nYNegative = IsFaceHidden(block, halo.Get(x, y-1, z));
+				bool nYPositive = IsFaceHidden(block, halo.Get(x, y+1, z));
+				bool nZNegative = IsFaceHidden(block, halo.Get(x, y, z-1));
+				bool nZPositive = IsFaceHidden(block, halo.Get(x, y, z+1));
 				// Create
-				CreateCube(x, y, z, nXNegative, nXPositive, nYNegative, nYPositive, nZNegative, nZPositive);
+				CreateCube(builder, halo, x, y, z, scale, nXNegative, nXPositive, nYNegative, nYPositive, nZNegative, nZPositive);
 			}
 		}
 	}
+}
 
-	m_bufferSize = 4;
-	glGenVertexArrays(1, &m_VAO);
-	m_VBO = new unsigned int[m_bufferSize];
-	glGenBuffers(m_bufferSize, m_VBO);
-
-	glBindVertexArray(m_VAO);
-
-	// Vertices
-	glBindBuffer(GL_ARRAY_BUFFER, m_VBO[0]);
-	glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(float), &m_vertices[0], GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-	glEnableVertexAttribArray(0);
-	// Normals
-	glBindBuffer(GL_ARRAY_BUFFER, m_VBO[1]);
-	glBufferData(GL_ARRAY_BUFFER, m_normals.size() * sizeof(float), &m_normals[0], GL_STATIC_DRAW);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-	glEnableVertexAttribArray(1);
-	// UV Coordinates
-	glBindBuffer(GL_ARRAY_BUFFER, m_VBO[2]);
-	glBufferData(GL_ARRAY_BUFFER, m_uvCoord.size() * sizeof(float), &m_uvCoord[0], GL_STATIC_DRAW);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
-	glEnableVertexAttribArray(2);
-	// Colors
-	glBindBuffer(GL_ARRAY_BUFFER, m_VBO[3]);
-	glBufferData(GL_ARRAY_BUFFER, m_colors.size() * sizeof(float), &m_colors[0], GL_STATIC_DRAW);
-	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)0);
-	glEnableVertexAttribArray(3);
-
-	glGenBuffers(1, &m_EBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(unsigned int), &m_indices[0], GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
-
-	m_indicesCount = m_indices.size();
-
-	// Clear vectors
-	std::vector<float>().swap(m_vertices);
-	std::vector<float>().swap(m_normals);
-	std::vector<float>().swap(m_uvCoord);
-	std::vector<float>().swap(m_colors);
-	std::vector<unsigned int>().swap(m_indices);
+void ChunkBuilder::CountFaces(const ChunkHalo &halo, int xBegin, int xEnd, int yBegin, int yEnd, MeshCounts &counts)
+{
+	// Same visibility tests as MeshRegion, without building anything
+	for (int x = xBegin; x < xEnd; x++)
+	{
+		for (int y = yBegin; y < yEnd; y++)
+		{
+			for (int z = 0; z < halo.GetSize(); z++)
+			{
+				if (halo.IsSolid(x, y, z) == false)
+					continue;
+				eBLOCKS block = halo.Get(x, y, z);
+				int *faces = counts.faces[(int)GetRenderPass(block)];
+				faces[(int)eDIRECTION::X_NEGATIVE] += IsFaceHidden(block, halo.Get(x-1, y, z)) ? 0 : 1;
+				faces[(int)eDIRECTION::X_POSITIVE] += IsFaceHidden(block, halo.Get(x+1, y, z)) ? 0 : 1;
+				faces[(int)eDIRECTION::Y_NEGATIVE] += IsFaceHidden(block, halo.Get(x, y-1, z)) ? 0 : 1;
+				faces[(int)eDIRECTION::Y_POSITIVE] += IsFaceHidden(block, halo.Get(x, y+1, z)) ? 0 : 1;
+				faces[(int)eDIRECTION::Z_NEGATIVE] += IsFaceHidden(block, halo.Get(x, y, z-1)) ? 0 : 1;
+				faces[(int)eDIRECTION::Z_POSITIVE] += IsFaceHidden(block, halo.Get(x, y, z+1)) ? 0 : 1;
+			}
+		}
+	}
 }
 
-void ChunkBuilder::Update(float deltaTime)
+void ChunkBuilder::CopyHalo(ChunkHalo &halo)
 {
+	halo.Resize(m_chunkSize, m_chunkHeight);
+
+	for (int x = 0; x < m_chunkSize; x++)
+	{
+		for (int y = 0; y < m_chunkHeight; y++)
+		{
+			for (int z = 0; z < m_chunkSize; z++)
+			{
+				if (m_blocks[x][y][z].IsDrawing())
+					halo.Set(x, y, z, m_blocks[x][y][z].GetBlockType());
+			}
+		}
+	}
+
+	// Nothing is ever seen from below the world, treat it as solid
+	for (int x = -1; x <= (int)m_chunkSize; x++)
+	{
+		for (int z = -1; z <= (int)m_chunkSize; z++)
+		{
+			halo.Set(x, -1, z, eBLOCKS::STONE);
+		}
+	}
+
+	// Borders from neighbouring chunks, missing neighbours are left as air. So are neighbours drawn at a
+	// coarser level: their surface doesn't follow these blocks, so the faces against them are kept and
+	// close the cracks where the coarse surface is lower. Coarse chunks keep their edge walls likewise.
+	const int last = m_chunkSize - 1;
+	auto fine = [](ChunkBuilder *chunk) { return chunk && chunk->m_coarse == false ? chunk : nullptr; };
+	ChunkBuilder *xNegative = fine(m_neighbours[(int)eDIRECTION::X_NEGATIVE]);
+	ChunkBuilder *xPositive = fine(m_neighbours[(int)eDIRECTION::X_POSITIVE]);
+	ChunkBuilder *zNegative = fine(m_neighbours[(int)eDIRECTION::Z_NEGATIVE]);
+	ChunkBuilder *zPositive = fine(m_neighbours[(int)eDIRECTION::Z_POSITIVE]);
+	for (int y = 0; y < m_chunkHeight; y++)
+	{
+		for (int i = 0; i < m_chunkSize; i++)
+		{
+			if (xNegative && xNegative->m_blocks[last][y][i].IsDrawing())
+				halo.Set(-1, y, i, xNegative->m_blocks[last][y][i].GetBlockType());
+			if (xPositive && xPositive->m_blocks[0][y][i].IsDrawing())
+				halo.Set(m_chunkSize, y, i, xPositive->m_blocks[0][y][i].GetBlockType());
+			if (zNegative && zNegative->m_blocks[i][y][last].IsDrawing())
+				halo.Set(i, y, -1, zNegative->m_blocks[i][y][last].GetBlockType());
+			if (zPositive && zPositive->m_blocks[i][y][0].IsDrawing())
+				halo.Set(i, y, m_chunkSize, zPositive->m_blocks[i][y][0].GetBlockType());
+		}
+	}
+
+	// Corner columns, reached through a neighbour's neighbour, only matter for ambient occlusion
+	ChunkBuilder *corners[4] = {
+		xNegative ? fine(xNegative->m_neighbours[(int)eDIRECTION::Z_NEGATIVE]) : nullptr,
+		xNegative ? fine(xNegative->m_neighbours[(int)eDIRECTION::Z_POSITIVE]) : nullptr,
+		xPositive ? fine(xPositive->m_neighbours[(int)eDIRECTION::Z_NEGATIVE]) : nullptr,
+		xPositive ? fine(xPositive->m_neighbours[(int)eDIRECTION::Z_POSITIVE]) : nullptr };
+	const int cornerX[4] = { -1, -1, (int)m_chunkSize, (int)m_chunkSize };
+	const int cornerZ[4] = { -1, (int)m_chunkSize, -1, (int)m_chunkSize };
+	for (int i = 0; i < 4; i++)
+	{
+		if (corners[i] == nullptr)
+			continue;
+		int srcX = cornerX[i] < 0 ? last : 0;
+		int srcZ = cornerZ[i] < 0 ? last : 0;
+		for (int y = 0; y < m_chunkHeight; y++)
+		{
+			if (corners[i]->m_blocks[srcX][y][srcZ].IsDrawing())
+				halo.Set(cornerX[i], y, cornerZ[i], corners[i]->m_blocks[srcX][y][srcZ].GetBlockType());
+		}
+	}
 }
 
-void ChunkBuilder::Draw()
+void ChunkBuilder::Unlink()
 {
-	m_model = glm::mat4(1.0f);
-	m_model = glm::translate(m_model, m_chunkPos);
+	// Neighbours stop culling against this chunk
+	for (int i = 0; i < (int)eDIRECTION::DIRECTION_MAX; i++)
+	{
+		if (m_neighbours[i])
+			m_neighbours[i]->SetNeighbour((eDIRECTION)(i ^ 1), nullptr);
+		m_neighbours[i] = nullptr;
+	}
+}
 
-	m_shader->Use();
-	m_shader->SetMatrix4("model", m_model);
-	glActiveTexture(GL_TEXTURE0);
-	m_texture->Use();
-	m_shader->SetInteger("mainTexture", 0);
+void ChunkBuilder::SetNeighbour(eDIRECTION direction, ChunkBuilder *neighbour)
+{
+	if (m_neighbours[(int)direction] == neighbour)
+		return;
+	m_neighbours[(int)direction] = neighbour;
 
-	glBindVertexArray(m_VAO);
-	glDrawElements(GL_TRIANGLES, (GLsizei)m_indicesCount, GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+	// The border against this neighbour changed, rebuild on the next update.
+	// Coarser levels don't cull against neighbours.
+	if (m_hasMesh[0])
+	{
+		m_sectionDirty = (1u << CHUNK_SECTION_COUNT) - 1;
+		m_meshDirty[0] = true;
+	}
+}
+
+void ChunkBuilder::MarkHaloDirty()
+{
+	// The halo runs the full height, so every section reads it
+	if (m_hasMesh[0])
+	{
+		m_sectionDirty = (1u << CHUNK_SECTION_COUNT) - 1;
+		m_meshDirty[0] = true;
+	}
+}
+
+eBLOCKS ChunkBuilder::GetBlock(int x, int y, int z)
+{
+	if (m_blocks[x][y][z].IsDrawing() == false)
+		return eBLOCKS::NONE;
+	return m_blocks[x][y][z].GetBlockType();
+}
+void ChunkBuilder::SetBlock(int x, int y, int z, eBLOCKS block)
+{
+	m_blocks[x][y][z].SetBlockType(block);
+	m_blocks[x][y][z].SetDraw(block != eBLOCKS::NONE);
+
+	MarkRegionDirty({ x, y, z }, { x + 1, y + 1, z + 1 });
+}
+
+void ChunkBuilder::MarkRegionDirty(glm::ivec3 begin, glm::ivec3 end)
+{
+	MarkDirty(begin.y, end.y);
+
+	// Neighbours see blocks on the border through their halo, including the diagonal ones for ambient occlusion
+	const bool xBorders[2] = { begin.x == 0, end.x == (int)m_chunkSize };
+	const bool zBorders[2] = { begin.z == 0, end.z == (int)m_chunkSize };
+	for (int zSide = 0; zSide < 2; zSide++)
+	{
+		ChunkBuilder *zNeighbour = m_neighbours[(int)eDIRECTION::Z_NEGATIVE + zSide];
+		if (zBorders[zSide] && zNeighbour)
+			zNeighbour->MarkDirty(begin.y, end.y);
+	}
+	for (int xSide = 0; xSide < 2; xSide++)
+	{
+		ChunkBuilder *xNeighbour = m_neighbours[(int)eDIRECTION::X_NEGATIVE + xSide];
+		if (xBorders[xSide] == false || xNeighbour == nullptr)
+			continue;
+		xNeighbour->MarkDirty(begin.y, end.y);
+		for (int zSide = 0; zSide < 2; zSide++)
+		{
+			ChunkBuilder *diagonal = xNeighbour->m_neighbours[(int)eDIRECTION::Z_NEGATIVE + zSide];
+			if (zBorders[zSide] && diagonal)
+				diagonal->MarkDirty(begin.y, end.y);
+		}
+	}
+}
+
+void ChunkBuilder::MarkDirty(int yBegin, int yEnd)
+{
+	// A block can change the faces and ambient occlusion of the blocks one away,
+	// which can be in the section above or below
+	const int sectionHeight = m_chunkHeight / CHUNK_SECTION_COUNT;
+	int first = std::max(yBegin - 1, 0) / sectionHeight;
+	int last = std::min(yEnd, (int)m_chunkHeight - 1) / sectionHeight;
+	for (int section = first; section <= last; section++)
+		m_sectionDirty |= 1u << section;
+
+	for (int lod = 0; lod < CHUNK_LOD_COUNT; lod++)
+	{
+		if (m_hasMesh[lod])
+			m_meshDirty[lod] = true;
+	}
+}
+
+void ChunkBuilder::SetMeshFormat(eMESH_FORMAT format)
+{
+	if (format == m_meshFormat)
+		return;
+	m_meshFormat = format;
+
+	// Every mesh has to be rebuilt in the new format
+	m_sectionDirty = (1u << CHUNK_SECTION_COUNT) - 1;
+	for (int lod = 0; lod < CHUNK_LOD_COUNT; lod++)
+	{
+		if (m_hasMesh[lod])
+			m_meshDirty[lod] = true;
+	}
+}
+
+void ChunkBuilder::UpdateLod(const glm::vec3 &cameraPosition)
+{
+	const float chunkWorldSize = m_chunkSize * 2.0f;
+	glm::vec3 center = glm::vec3(m_chunkSize - 1.0f, m_chunkHeight - 1.0f, m_chunkSize - 1.0f);
+	float distance = glm::length(center - cameraPosition) / chunkWorldSize;
+
+	int lod = m_lod;
+	while (lod < CHUNK_LOD_COUNT - 1 && distance > m_lodDistances[lod + 1])
+		lod++;
+	while (lod > 0 && distance < m_lodDistances[lod] - m_lodHysteresis)
+		lod--;
+
+	if (lod == m_lod)
+		return;
+
+	// Meshing waits behind the frame budget, so the old level is drawn until the new one is built
+	m_lod = lod;
+	if (m_hasMesh[m_lod])
+		ShowLod();
+	else
+		m_meshDirty[m_lod] = true;
+	UpdateCoarse();
 }
 
-unsigned int ChunkBuilder::AddVertex(glm::vec3 point, glm::vec3 normal, glm::vec2 uvCoords, float r, float g, float b, float a)
+void ChunkBuilder::ShowLod()
 {
-	static int index = -1;
-	index++;
+	if (m_drawLod == m_lod)
+		return;
+
+	// With a mesh cache to restore it from, the level being left gives up its GPU memory
+	if (MeshCache::Get())
+	{
+		if (m_drawLod == 0)
+		{
+			for (ChunkMesh &mesh : m_sectionMeshes)
+				mesh.Destroy();
+		}
+		else
+			m_meshes[m_drawLod].Destroy();
+		m_hasMesh[m_drawLod] = false;
+		m_meshDirty[m_drawLod] = false;
+	}
+	m_drawLod = m_lod;
+	UpdateCoarse();
+}
 
-	m_vertices.push_back(point.x);
-	m_vertices.push_back(point.y);
-	m_vertices.push_back(point.z);
+void ChunkBuilder::UpdateCoarse()
+{
+	// Coarse from the moment the next level is picked until it's back at full resolution and drawn,
+	// an extra wall hidden behind full resolution blocks is better than a crack
+	bool coarse = m_lod > 0 || m_drawLod > 0;
+	if (coarse == m_coarse)
+		return;
+	m_coarse = coarse;
+	for (ChunkBuilder *neighbour : m_neighbours)
+	{
+		if (neighbour)
+			neighbour->MarkHaloDirty();
+	}
+}
 
-	m_normals.push_back(normal.x);
-	m_normals.push_back(normal.y);
-	m_normals.push_back(normal.z);
+void ChunkBuilder::ReleaseMeshes()
+{
+	for (ChunkMesh &mesh : m_sectionMeshes)
+		mesh.Destroy();
+	for (ChunkMesh &mesh : m_meshes)
+		mesh.Destroy();
+	for (int lod = 0; lod < CHUNK_LOD_COUNT; lod++)
+	{
+		m_hasMesh[lod] = false;
+		m_meshDirty[lod] = false;
+	}
+	m_meshDirty[m_lod] = true;
+	m_drawLod = m_lod;
+	UpdateCoarse();
+}
 
-	m_uvCoord.push_back(uvCoords.x);
-	m_uvCoord.push_back(uvCoords.y);
+void ChunkBuilder::Update(float deltaTime)
+{
+	// Edits made since the last update are rebuilt together, only touching their sections
+	if (m_meshDirty[m_lod] == false)
+		return;
+	if (m_lod == 0 && m_hasMesh[0])
+		CreateSectionMeshes();
+	else
+		CreateMesh(m_lod);
+	ShowLod();
+}
 
-	m_colors.push_back(r);
-	m_colors.push_back(g);
-	m_colors.push_back(b);
-	m_colors.push_back(a);
+void ChunkBuilder::Draw(const glm::vec3 &chunkOffset, eRENDER_PASS pass)
+{
+	Shader *shader = m_shader;
+	if (m_meshFormat == eMESH_FORMAT::PACKED_FACES)
+		shader = m_faceShader;
+	else if (m_meshFormat == eMESH_FORMAT::PULLED_FACES)
+	{
+		shader = m_pullShader;
+		FaceBuffer::Get()->Bind();
+	}
+	shader->Use();
+	shader->SetVector3("chunkOffset", chunkOffset);
+	glActiveTexture(GL_TEXTURE0);
+	m_texture->Use();
+	shader->SetInteger("mainTexture", 0);
+	shader->SetFloat("alphaCutoff", pass == eRENDER_PASS::CUTOUT ? 0.5f : 0.0f);
+	if (IsPackedFormat(m_meshFormat))
+		shader->SetInteger("faceScale", 1 << m_drawLod);
+
+	// Culling and sorting are done in chunk space, where the numbers stay small
+	const glm::vec3 cameraPosition = -chunkOffset;
+	glm::vec3 boundsMin = glm::vec3(-1.0f);
+	glm::vec3 boundsMax = glm::vec3(m_chunkSize * 2.0f - 1.0f, m_chunkHeight * 2.0f - 1.0f, m_chunkSize * 2.0f - 1.0f);
+	if (m_drawLod > 0)
+	{
+		DrawMesh(m_meshes[m_drawLod], cameraPosition, pass, boundsMin, boundsMax);
+		return;
+	}
 
-	return index;
+	const float sectionWorldHeight = (m_chunkHeight / CHUNK_SECTION_COUNT) * 2.0f;
+	for (int section = 0; section < CHUNK_SECTION_COUNT; section++)
+	{
+		boundsMin.y = section * sectionWorldHeight - 1.0f;
+		boundsMax.y = boundsMin.y + sectionWorldHeight;
+		DrawMesh(m_sectionMeshes[section], cameraPosition, pass, boundsMin, boundsMax);
+	}
 }
-void ChunkBuilder::AddTriangle(unsigned int firstIndex, unsigned int secondIndex, unsigned int thirdIndex)
+
+void ChunkBuilder::DrawMesh(ChunkMesh &mesh, const glm::vec3 &cameraPosition, eRENDER_PASS pass, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
 {
-	m_indices.push_back(firstIndex);
-	m_indices.push_back(secondIndex);
-	m_indices.push_back(thirdIndex);
+	if (mesh.HasPass(pass) == false)
+		return;
+	if (pass == eRENDER_PASS::TRANSLUCENT)
+		mesh.SortTranslucent(cameraPosition);
+
+	// Every face of a direction lies inside the mesh bounds, so when the camera is behind
+	// the mesh along that direction all of them face away and the whole range can be skipped.
+	bool visible[(int)eDIRECTION::DIRECTION_MAX];
+	visible[(int)eDIRECTION::X_NEGATIVE] = cameraPosition.x < boundsMax.x;
+	visible[(int)eDIRECTION::X_POSITIVE] = cameraPosition.x > boundsMin.x;
+	visible[(int)eDIRECTION::Y_NEGATIVE] = cameraPosition.y < boundsMax.y;
+	visible[(int)eDIRECTION::Y_POSITIVE] = cameraPosition.y > boundsMin.y;
+	visible[(int)eDIRECTION::Z_NEGATIVE] = cameraPosition.z < boundsMax.z;
+	visible[(int)eDIRECTION::Z_POSITIVE] = cameraPosition.z > boundsMin.z;
+
+	mesh.Draw(pass, visible);
 }
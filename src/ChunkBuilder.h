@@ -4,52 +4,176 @@
 #include "Math.h"
 
 #include "Blocks.h"
+#include "ChunkMesh.h"
+#include "MeshBuilder.h"
+
+#define CHUNK_LOD_COUNT 3
+#define CHUNK_SECTION_COUNT 4
+#define CHUNK_MAX_SLABS 16
 
 class Shader;
 class Texture;
+class ChunkHalo;
 
 class ChunkBuilder
 {
 public:
-	ChunkBuilder(Shader *shader, Texture *texture);
+	ChunkBuilder(Shader *shader, Shader *faceShader, Shader *pullShader, Texture *texture);
 	~ChunkBuilder();
 
+	// Allocates and generates the blocks, the mesh is built on the next Update.
 	void Create();
-	void CreateCube(float x, float y, float z, 
+	void CreateCube(MeshBuilder &builder, const ChunkHalo &halo, int x, int y, int z, int scale,
 					bool xNegativeVisible, bool xPositiveVisible, 
 					bool yNegativeVisible, bool yPositiveVisible, 
 					bool zNegativeVisible, bool zPositiveVisible);
-	void CreateMesh();
+	// Level 0 is full resolution, each level above halves it.
+	void CreateMesh(int lod = 0);
+	// Meshes the whole chunk at a level of detail into builder without touching the GPU.
+	// Given the mesh it will be uploaded to, pulled faces can be built straight into it.
+	void BuildMesh(MeshBuilder &builder, eMESH_FORMAT format, int lod, ChunkMesh *target = nullptr);
+	// Slabs a level is split into to mesh in parallel, 1 without a ThreadPool
+	int GetSlabCount(int lod);
+
+	// Chunk local block access. Edits only mark the sections they touch (and the
+	// bordering sections of neighbour chunks) dirty, they are rebuilt together on the next Update.
+	eBLOCKS GetBlock(int x, int y, int z);
+	void SetBlock(int x, int y, int z, eBLOCKS block);
+	// Sets every block from begin up to end (end exclusive) to edit(x, y, z, block), returning how many changed.
+	// The box is marked dirty once for the whole edit rather than once per block.
+	template<typename Edit>
+	int EditRegion(glm::ivec3 begin, glm::ivec3 end, const Edit &edit)
+	{
+		int changed = 0;
+		for (int x = begin.x; x < end.x; x++)
+		{
+			for (int y = begin.y; y < end.y; y++)
+			{
+				Block *row = m_blocks[x][y];
+				for (int z = begin.z; z < end.z; z++)
+				{
+					eBLOCKS block = row[z].IsDrawing() ? row[z].GetBlockType() : eBLOCKS::NONE;
+					eBLOCKS edited = edit(x, y, z, block);
+					if (edited == block)
+						continue;
+					row[z].SetBlockType(edited);
+					row[z].SetDraw(edited != eBLOCKS::NONE);
+					changed++;
+				}
+			}
+		}
+		if (changed > 0)
+			MarkRegionDirty(begin, end);
+		return changed;
+	}
+
+	// Switches between expanded vertices and packed instanced faces, rebuilding every mesh.
+	void SetMeshFormat(eMESH_FORMAT format);
+	inline eMESH_FORMAT GetMeshFormat() { return m_meshFormat; }
+
+	// Picks the level of detail for the camera distance, building that level's mesh on the next update if needed.
+	// The level drawn only switches once the new one has a mesh. The camera position is relative to the chunk's origin.
+	void UpdateLod(const glm::vec3 &cameraPosition);
+	inline int GetLod() { return m_lod; }
+	// Frees every mesh's GPU memory, the current level is rebuilt on the next Update.
+	void ReleaseMeshes();
+	// Run length encodes the blocks and frees them, for chunks that are kept but not used.
+	// Blocks can't be read, edited or meshed until they are decompressed again.
+	void CompressBlocks();
+	void DecompressBlocks();
+	inline bool IsCompressed() { return m_blocks == nullptr && m_packedBlocks.empty() == false; }
+	// Bytes of blocks and meshes reported to the MemoryBudget, all given back when the chunk is destroyed
+	size_t GetMemoryUsage();
+
+	// Position in chunks, set before Create so the terrain is generated there
+	inline void SetChunkCoord(glm::ivec3 coord) { m_chunkCoord = coord; }
+	inline glm::ivec3 GetChunkCoord() { return m_chunkCoord; }
+
+	// Links the chunk next to this one so faces against it can be culled.
+	// Marks the mesh for rebuilding when a neighbour arrives or leaves after meshing.
+	void SetNeighbour(eDIRECTION direction, ChunkBuilder *neighbour);
+	inline ChunkBuilder *GetNeighbour(eDIRECTION direction) { return m_neighbours[(int)direction]; }
+	// Marks the mesh for rebuilding when something its halo reads from another chunk changed,
+	// like a diagonal chunk (read for the corners' ambient occlusion) arriving or leaving.
+	void MarkHaloDirty();
+	// Unlinks the chunk from all of its neighbours, as destroying it does.
+	void Unlink();
+
+	// Whether the next Update has a mesh to build
+	inline bool IsMeshDirty() { return m_meshDirty[m_lod]; }
 
 	void Update(float deltaTime);
-	void Draw();
+	// Draws the chunk with its origin at chunkOffset from the camera, worked out by the caller
+	// in double precision so the chunk stays steady however far it is from the world's origin.
+	void Draw(const glm::vec3 &chunkOffset, eRENDER_PASS pass);
 
 private:
-	unsigned int AddVertex(glm::vec3 point, glm::vec3 normal, glm::vec2 uvCoords, float r, float g, float b, float a);
-	void AddTriangle(unsigned int firstIndex, unsigned int secondIndex, unsigned int thirdIndex);
+	void AddFace(MeshBuilder &builder, const ChunkHalo &halo, eRENDER_PASS pass, glm::ivec3 block,
+				glm::vec3 p1, glm::vec3 p2, glm::vec3 p3, glm::vec3 p4,
+				glm::vec3 normal, int textureIndex);
+	int VertexAO(const ChunkHalo &halo, glm::ivec3 block, glm::ivec3 normal, glm::vec3 corner);
+
+	// Draws the current level from now on, the one left gives up its GPU memory when the cache can restore it
+	void ShowLod();
+	// Remeshes the neighbours when the chunk starts or stops being drawn coarse, they only cull against it at full resolution
+	void UpdateCoarse();
+
+	void CreateSectionMeshes();
+	// Meshes rows yBegin to yEnd of halo, in parallel slabs when there is a ThreadPool,
+	// or restores them from the MeshCache when it has them
+	void BuildRegion(MeshBuilder &builder, const ChunkHalo &halo, eMESH_FORMAT format, int lod, int section, int yBegin, int yEnd, ChunkMesh *target);
+	void MeshRegion(MeshBuilder &builder, const ChunkHalo &halo, int scale, int xBegin, int xEnd, int yBegin, int yEnd);
+	// Marks the sections holding rows yBegin to yEnd dirty, and the ones those rows' blocks are seen from
+	void MarkDirty(int yBegin, int yEnd);
+	// Marks an edited box dirty, along with the neighbours that see it through their halo
+	void MarkRegionDirty(glm::ivec3 begin, glm::ivec3 end);
+
+	void DrawMesh(ChunkMesh &mesh, const glm::vec3 &cameraPosition, eRENDER_PASS pass, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax);
+
+	// Exact faces MeshRegion will emit, for sizing its outputs up front
+	void CountFaces(const ChunkHalo &halo, int xBegin, int xEnd, int yBegin, int yEnd, MeshCounts &counts);
+	void CopyHalo(ChunkHalo &halo);
+
+	void AllocateBlocks();
+	void FreeBlocks();
+	inline size_t GetBlocksSize() { return (size_t)m_chunkSize * m_chunkHeight * m_chunkSize * sizeof(Block); }
 
 private:
-	glm::vec3 m_chunkPos;
+	glm::ivec3 m_chunkCoord = { 0, 0, 0 };
 
 	const unsigned int m_chunkSize = 32;
 	const unsigned int m_chunkHeight = 32;
-	Block ***m_blocks;
+	const int m_seaLevel = 12;
+	// Narrowest a parallel meshing slab is made, thinner slabs cost more to hand out than they save
+	const int m_minSlabWidth = 2;
+	Block ***m_blocks = nullptr;
+	// (block, run length) pairs in [x][y][z] order while compressed
+	std::vector<unsigned char> m_packedBlocks;
 
-	int m_bufferSize;
-	unsigned int m_VAO;
-	unsigned int *m_VBO;
-	unsigned int m_EBO;
+	ChunkBuilder *m_neighbours[(int)eDIRECTION::DIRECTION_MAX] = { };
 
-	int m_indicesCount = 0;
-	std::vector<unsigned int> m_indices;
-	std::vector<float> m_vertices;
-	std::vector<float> m_normals;
-	std::vector<float> m_uvCoord;
-	std::vector<float> m_colors;
+	// Full resolution is meshed per section of the column so edits only rebuild what they touch,
+	// coarser levels are one mesh each (m_meshes[0] is unused)
+	eMESH_FORMAT m_meshFormat = eMESH_FORMAT::VERTICES;
+	ChunkMesh m_sectionMeshes[CHUNK_SECTION_COUNT];
+	unsigned int m_sectionDirty = 0;
+	ChunkMesh m_meshes[CHUNK_LOD_COUNT];
+	bool m_hasMesh[CHUNK_LOD_COUNT] = { };
+	bool m_meshDirty[CHUNK_LOD_COUNT] = { };
 
-	glm::mat4 m_model;
+	// Distances in chunks where each level starts, a level is only left again once the camera is
+	// m_lodHysteresis chunks back inside it so standing on a boundary doesn't flip between meshes.
+	int m_lod = 0;
+	// Level being drawn, behind m_lod until its mesh is built
+	int m_drawLod = 0;
+	// Drawn or about to be drawn at a coarser level than full resolution
+	bool m_coarse = false;
+	const float m_lodDistances[CHUNK_LOD_COUNT] = { 0.0f, 6.0f, 12.0f };
+	const float m_lodHysteresis = 0.5f;
 
 	Shader *m_shader;
+	Shader *m_faceShader;
+	Shader *m_pullShader;
 	Texture *m_texture;
 
 };
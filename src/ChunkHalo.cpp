@@ -0,0 +1,88 @@
+#include "ChunkHalo.h"
+
+ChunkHalo::ChunkHalo()
+{ }
+ChunkHalo::~ChunkHalo()
+{ }
+
+void ChunkHalo::Resize(int size, int height)
+{
+	m_size = size;
+	m_height = height;
+	m_blocks.assign((size_t)(size + 2) * (height + 2) * (size + 2), eBLOCKS::NONE);
+}
+
+void ChunkHalo::Downsample(const ChunkHalo &source, int factor)
+{
+	Resize(source.m_size / factor, source.m_height / factor);
+
+	// The border is left as air so coarse chunks keep their edge walls, covering the cracks where a
+	// full resolution neighbour's surface is lower. That neighbour keeps its walls too, see ChunkBuilder::CopyHalo.
+	for (int x = -1; x <= m_size; x++)
+	{
+		for (int z = -1; z <= m_size; z++)
+		{
+			Set(x, -1, z, eBLOCKS::STONE);
+		}
+	}
+
+	const int volume = factor * factor * factor;
+	for (int x = 0; x < m_size; x++)
+	{
+		for (int y = 0; y < m_height; y++)
+		{
+			for (int z = 0; z < m_size; z++)
+			{
+				int solid = 0;
+				eBLOCKS top = eBLOCKS::NONE;
+				for (int dy = 0; dy < factor; dy++)
+				{
+					for (int dx = 0; dx < factor; dx++)
+					{
+						for (int dz = 0; dz < factor; dz++)
+						{
+							eBLOCKS block = source.Get(x * factor + dx, y * factor + dy, z * factor + dz);
+							if (block == eBLOCKS::NONE)
+								continue;
+							solid++;
+							top = block;
+						}
+					}
+				}
+
+				if (solid * 2 >= volume)
+					Set(x, y, z, top);
+			}
+		}
+	}
+}
+
+uint64_t ChunkHalo::Hash(int yBegin, int yEnd) const
+{
+	// FNV-1a over every x slice's run of rows, the rows of one slice are contiguous
+	uint64_t hash = 14695981039346656037ull;
+	const size_t rowLength = (size_t)(m_size + 2);
+	const size_t runLength = (size_t)(yEnd - yBegin + 2) * rowLength;
+	for (int x = -1; x <= m_size; x++)
+	{
+		const eBLOCKS *run = &m_blocks[Index(x, yBegin - 1, -1)];
+		for (size_t i = 0; i < runLength; i++)
+		{
+			hash ^= (uint64_t)run[i];
+			hash *= 1099511628211ull;
+		}
+	}
+	hash ^= (uint64_t)m_size << 32 | (uint64_t)m_height;
+	return hash * 1099511628211ull;
+}
+
+ChunkHalo &ChunkHalo::GetThreadHalo()
+{
+	static thread_local ChunkHalo halo;
+	return halo;
+}
+ChunkHalo &ChunkHalo::GetThreadLodHalo()
+{
+	static thread_local ChunkHalo halo;
+	return halo;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Common.h"
+
+#include "Blocks.h"
+
+// Block types of one chunk plus a one block border copied from its neighbours,
+// so the mesher can cull faces across chunk edges without touching other chunks.
+// Coordinates are chunk local and range from -1 to size (inclusive).
+class ChunkHalo
+{
+public:
+	ChunkHalo();
+	~ChunkHalo();
+
+	void Resize(int size, int height);
+	// Builds a coarser copy of source, one cell per factor^3 blocks.
+	// A cell is solid when at least half its blocks are, and takes the type of its topmost block.
+	void Downsample(const ChunkHalo &source, int factor);
+
+	inline eBLOCKS Get(int x, int y, int z) const { return m_blocks[Index(x, y, z)]; }
+	inline void Set(int x, int y, int z, eBLOCKS block) { m_blocks[Index(x, y, z)] = block; }
+
+	inline bool IsSolid(int x, int y, int z) const { return Get(x, y, z) != eBLOCKS::NONE; }
+	inline bool IsOpaque(int x, int y, int z) const { return ::IsOpaque(Get(x, y, z)); }
+
+	// Hash of the blocks meshing rows yBegin to yEnd (exclusive) reads, border rows included.
+	// Meshes built from halos with the same hash are the same.
+	uint64_t Hash(int yBegin, int yEnd) const;
+
+	inline int GetSize() const { return m_size; }
+	inline int GetHeight() const { return m_height; }
+
+	// Halo owned by the calling thread, reused between meshes.
+	static ChunkHalo &GetThreadHalo();
+	static ChunkHalo &GetThreadLodHalo();
+
+private:
+	inline int Index(int x, int y, int z) const { return ((x + 1) * (m_height + 2) + (y + 1)) * (m_size + 2) + (z + 1); }
+
+private:
+	int m_size = 0;
+	int m_height = 0;
+	std::vector<eBLOCKS> m_blocks;
+
+};
@@ -1,8 +1,715 @@
 #include "ChunkManager.h"
 
 #include "Camera.h"
+#include "MemoryBudget.h"
+#include "MeshCache.h"
+#include "ThreadPool.h"
 
-ChunkManager::ChunkManager()
-{ }
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+
+// Neighbours a chunk culls against, chunks are a single layer tall
+static const eDIRECTION s_horizontalDirections[4] = { eDIRECTION::X_NEGATIVE, eDIRECTION::X_POSITIVE, eDIRECTION::Z_NEGATIVE, eDIRECTION::Z_POSITIVE };
+static const glm::ivec3 s_directionOffsets[(int)eDIRECTION::DIRECTION_MAX] = {
+	{ -1, 0, 0 }, { 1, 0, 0 },
+	{ 0, -1, 0 }, { 0, 1, 0 },
+	{ 0, 0, -1 }, { 0, 0, 1 },
+};
+// Chunks a chunk's halo reads its corner columns from, through a neighbour's neighbour
+static const glm::ivec3 s_diagonalOffsets[4] = { { -1, 0, -1 }, { -1, 0, 1 }, { 1, 0, -1 }, { 1, 0, 1 } };
+
+ChunkManager::ChunkManager(Shader *shader, Shader *faceShader, Shader *pullShader, Texture *texture)
+	: m_shader { shader }
+	, m_faceShader { faceShader }
+	, m_pullShader { pullShader }
+	, m_texture { texture }
+{
+	spdlog::info("Created Chunk Manager.");
+	SetRadii(8, 10);
+}
 ChunkManager::~ChunkManager()
-{ }
+{
+	spdlog::info("Destroyed Chunk Manager.");
+}
+
+size_t ChunkManager::CoordHash::operator()(const glm::ivec3 &coord) const
+{
+	size_t hash = std::hash<int>()(coord.x);
+	hash = hash * 31 + std::hash<int>()(coord.y);
+	return hash * 31 + std::hash<int>()(coord.z);
+}
+
+void ChunkManager::Update(float deltaTime, Camera& camera)
+{
+	m_cameraPos = camera.position;
+	m_cameraFront = camera.front;
+	m_cameraChunk = { (int)std::floor(m_cameraPos.x / m_chunkWorldSize), 0, (int)std::floor(m_cameraPos.z / m_chunkWorldSize) };
+
+	// Gribb-Hartmann planes from the view projection's rows, relative to the camera like the view
+	glm::mat4 viewProjection = camera.proj * camera.view;
+	for (int i = 0; i < 3; i++)
+	{
+		for (int side = 0; side < 2; side++)
+		{
+			float sign = side == 0 ? 1.0f : -1.0f;
+			glm::vec4 &plane = m_frustum[i * 2 + side];
+			for (int column = 0; column < 4; column++)
+				plane[column] = viewProjection[column][3] + sign * viewProjection[column][i];
+		}
+	}
+
+	// Queued priorities go stale once the camera has moved or turned far enough
+	if (glm::length(m_cameraPos - m_epochPos) > m_epochDistance || glm::dot(m_cameraFront, m_epochFront) < m_epochAngle)
+	{
+		m_loadEpoch++;
+		m_epochPos = m_cameraPos;
+		m_epochFront = m_cameraFront;
+	}
+
+	if (m_cameraChunk != m_windowCenter)
+		MoveWindow(m_cameraChunk);
+	QueueChunks();
+
+	// Chunks past the unload radius are only evicted once they have stayed out for the grace
+	// period, so crossing back and forth over a border keeps them loaded
+	for (ChunkSlot &slot : m_slots)
+	{
+		if (slot.chunk == nullptr)
+			continue;
+		if (IsInRadius(slot.coord, m_unloadRadius))
+			slot.outsideTime = 0.0f;
+		else if ((slot.outsideTime += deltaTime) >= m_unloadGrace)
+			EvictChunk(slot);
+	}
+
+	if (MemoryBudget *memory = MemoryBudget::Get())
+		UpdateMemory(deltaTime, *memory);
+
+	// The budget moves in proportion to the time frames have spare (or are over by), so it settles
+	// where frames just make the target instead of stepping back and forth across it
+	m_frameTime += (deltaTime - m_frameTime) * m_frameTimeSmoothing;
+	float slack = (m_targetFrameTime * (1.0f + m_frameHeadroom) - m_frameTime) / m_targetFrameTime;
+	m_budget *= 1.0f + std::clamp(slack, -m_maxBudgetStep, m_maxBudgetStep);
+	m_budget = std::min(m_maxBudget, std::max(m_minBudget, m_budget));
+
+	// Integration stops once the budget is spent and carries on next update. Some meshing and
+	// loading is always done so streaming can't stall however slow the frames get.
+	auto start = std::chrono::steady_clock::now();
+	auto overBudget = [this, &start]
+		{
+			return std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count() >= m_budget;
+		};
+
+	// Chunks that left the window give back their memory and GL objects
+	while (m_retired.empty() == false && overBudget() == false)
+		m_retired.pop_back();
+
+	// Nearest meshes first, they are the ones most likely to be seen
+	m_meshQueue.clear();
+	for (ChunkSlot &slot : m_slots)
+	{
+		if (slot.chunk == nullptr)
+			continue;
+		slot.chunk->UpdateLod(-GetChunkOffset(slot.coord));
+		if (slot.chunk->IsMeshDirty() && IsReadyToMesh(slot.coord, slot.chunk.get()))
+			m_meshQueue.emplace_back(GetLoadPriority(slot.coord), slot.chunk.get());
+	}
+	std::sort(m_meshQueue.begin(), m_meshQueue.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+	for (size_t i = 0; i < m_meshQueue.size(); i++)
+	{
+		if (i > 0 && overBudget())
+			break;
+		ChunkBuilder *chunk = m_meshQueue[i].second;
+		chunk->Update(deltaTime);
+		MarkChunkDirty(GetSlot(chunk->GetChunkCoord()), eCHUNK_DIRTY::MESH);
+	}
+
+	bool loaded = false;
+	while (m_loadQueue.empty() == false && (loaded == false || overBudget() == false))
+	{
+		if (LoadChunks() == 0)
+			break;
+		loaded = true;
+	}
+
+	DispatchEvents();
+}
+
+int ChunkManager::Subscribe(ChunkListener listener)
+{
+	m_listeners.emplace_back(++m_lastListener, std::move(listener));
+	return m_lastListener;
+}
+void ChunkManager::Unsubscribe(int id)
+{
+	std::erase_if(m_listeners, [id](const auto &listener) { return listener.first == id; });
+}
+
+void ChunkManager::MarkChunkDirty(ChunkSlot &slot, eCHUNK_DIRTY flag)
+{
+	if (slot.dirty == 0)
+		m_dirtyChunks.push_back(slot.coord);
+	slot.dirty |= 1u << (int)flag;
+}
+
+void ChunkManager::MarkEdited(ChunkSlot &slot)
+{
+	MarkChunkDirty(slot, eCHUNK_DIRTY::BLOCKS);
+	MarkChunkDirty(slot, eCHUNK_DIRTY::LIGHT);
+	MarkChunkDirty(slot, eCHUNK_DIRTY::SAVE);
+}
+
+void ChunkManager::DispatchEvents()
+{
+	// Chunks are looked up now rather than when the event was raised, they may have gone since
+	for (ChunkEvent &event : m_events)
+	{
+		if (event.type == eCHUNK_EVENT::LOADED)
+			event.chunk = GetChunk(event.coord);
+	}
+	// Changes since the last update, one event per chunk however many times it changed.
+	// Chunks that unloaded since hand their bits to the unload event and are skipped here.
+	for (glm::ivec3 coord : m_dirtyChunks)
+	{
+		ChunkSlot &slot = GetSlot(coord);
+		if (slot.chunk == nullptr || slot.coord != coord || slot.dirty == 0)
+			continue;
+		m_events.push_back({ eCHUNK_EVENT::CHANGED, coord, slot.dirty, slot.chunk.get() });
+		slot.dirty = 0;
+	}
+	m_dirtyChunks.clear();
+
+	// Swapped out first, so listeners that change the world raise events for the next dispatch
+	m_events.swap(m_dispatching);
+	m_events.clear();
+	if (m_dispatching.empty())
+		return;
+	for (auto &[id, listener] : m_listeners)
+		listener(m_dispatching);
+}
+
+void ChunkManager::QueueChunks()
+{
+	// Chunks only come into the radius when the camera crosses into another chunk
+	const int radius = GetActiveRadius();
+	if (m_cameraChunk == m_queuedChunk && radius == m_queuedRadius)
+		return;
+	m_queuedChunk = m_cameraChunk;
+	m_queuedRadius = radius;
+
+	for (int z = -radius; z <= radius; z++)
+	{
+		for (int x = -radius; x <= radius; x++)
+		{
+			glm::ivec3 coord = m_cameraChunk + glm::ivec3(x, 0, z);
+			if (IsInRadius(coord, radius) == false)
+				continue;
+			// The window holds the radius, so the slot is either this chunk's already or free
+			ChunkSlot &slot = GetSlot(coord);
+			if (slot.chunk || slot.queued)
+				continue;
+			slot.coord = coord;
+			slot.queued = true;
+			m_loadQueue.push_back({ GetLoadPriority(coord), m_loadEpoch, coord });
+			std::push_heap(m_loadQueue.begin(), m_loadQueue.end());
+		}
+	}
+}
+
+int ChunkManager::LoadChunks()
+{
+	// One chunk per thread
+	ThreadPool *pool = ThreadPool::Get();
+	const int batchSize = pool ? pool->GetThreadCount() + 1 : 1;
+
+	std::vector<glm::ivec3> missing;
+	int restored = 0;
+	while (m_loadQueue.empty() == false && (int)missing.size() + restored < batchSize)
+	{
+		std::pop_heap(m_loadQueue.begin(), m_loadQueue.end());
+		LoadRequest request = m_loadQueue.back();
+		m_loadQueue.pop_back();
+
+		// Left the radius while it waited, or its slot was recycled
+		ChunkSlot &slot = GetSlot(request.coord);
+		if (slot.queued == false || slot.coord != request.coord)
+			continue;
+		if (IsInRadius(request.coord, GetActiveRadius()) == false)
+		{
+			slot.queued = false;
+			continue;
+		}
+
+		// Worked out for an older camera, put it back if something else should go first now
+		if (request.epoch != m_loadEpoch)
+		{
+			request.priority = GetLoadPriority(request.coord);
+			request.epoch = m_loadEpoch;
+			if (m_loadQueue.empty() == false && m_loadQueue.front().priority < request.priority)
+			{
+				m_loadQueue.push_back(request);
+				std::push_heap(m_loadQueue.begin(), m_loadQueue.end());
+				continue;
+			}
+		}
+
+		slot.queued = false;
+
+		// Parked chunks come back as they were left, only needing a mesh
+		auto parked = m_parkedChunks.find(request.coord);
+		if (parked != m_parkedChunks.end())
+		{
+			std::unique_ptr<ChunkBuilder> chunk = std::move(*parked->second);
+			m_parked.erase(parked->second);
+			m_parkedChunks.erase(parked);
+			chunk->DecompressBlocks();
+			chunk->SetMeshFormat(m_meshFormat);
+			PlaceChunk(request.coord, std::move(chunk));
+			restored++;
+			continue;
+		}
+		missing.push_back(request.coord);
+	}
+	if (missing.empty())
+		return restored;
+
+	const int loadCount = (int)missing.size();
+	std::vector<std::unique_ptr<ChunkBuilder>> chunks(loadCount);
+	for (int i = 0; i < loadCount; i++)
+	{
+		chunks[i] = std::make_unique<ChunkBuilder>(m_shader, m_faceShader, m_pullShader, m_texture);
+		chunks[i]->SetChunkCoord(missing[i]);
+		chunks[i]->SetMeshFormat(m_meshFormat);
+	}
+
+	// Generation only touches the chunk's own blocks
+	auto generate = [&chunks](int i) { chunks[i]->Create(); };
+	if (pool)
+		pool->ParallelFor(loadCount, generate);
+	else
+	{
+		for (int i = 0; i < loadCount; i++)
+			generate(i);
+	}
+
+	for (int i = 0; i < loadCount; i++)
+		PlaceChunk(missing[i], std::move(chunks[i]));
+	return loadCount + restored;
+}
+
+void ChunkManager::PlaceChunk(glm::ivec3 coord, std::unique_ptr<ChunkBuilder> chunk)
+{
+	ChunkBuilder *placed = chunk.get();
+	ChunkSlot &slot = GetSlot(coord);
+	slot.coord = coord;
+	slot.chunk = std::move(chunk);
+	slot.outsideTime = 0.0f;
+	slot.dirty = 0;
+	m_chunkCount++;
+	LinkNeighbours(coord, placed);
+	m_events.push_back({ eCHUNK_EVENT::LOADED, coord, 0, nullptr });
+}
+
+std::unique_ptr<ChunkBuilder> ChunkManager::UnloadChunk(ChunkSlot &slot)
+{
+	std::unique_ptr<ChunkBuilder> chunk = std::move(slot.chunk);
+	m_chunkCount--;
+	if (chunk.get() == m_lastChunk)
+		m_lastChunk = nullptr;
+	m_events.push_back({ eCHUNK_EVENT::UNLOADED, slot.coord, slot.dirty, nullptr });
+	slot.dirty = 0;
+	// Neighbours are dirtied as the chunk unlinks, diagonals aren't linked to it
+	MarkDiagonalsDirty(slot.coord);
+	return chunk;
+}
+
+void ChunkManager::EvictChunk(ChunkSlot &slot, bool park)
+{
+	std::unique_ptr<ChunkBuilder> chunk = UnloadChunk(slot);
+	chunk->Unlink();
+	if (park == false || m_parkCapacity == 0)
+	{
+		// Destroyed within a later update's budget
+		m_retired.push_back(std::move(chunk));
+		return;
+	}
+
+	// Parked chunks keep their blocks but give up their GPU memory, the least recently parked go first
+	chunk->ReleaseMeshes();
+	m_parked.push_front(std::move(chunk));
+	m_parkedChunks[slot.coord] = m_parked.begin();
+	while (m_parked.size() > m_parkCapacity)
+	{
+		m_parkedChunks.erase(m_parked.back()->GetChunkCoord());
+		m_retired.push_back(std::move(m_parked.back()));
+		m_parked.pop_back();
+	}
+}
+
+bool ChunkManager::IsInWindow(glm::ivec3 coord)
+{
+	const int halfSize = m_windowSize / 2;
+	return std::abs(coord.x - m_windowCenter.x) <= halfSize && std::abs(coord.z - m_windowCenter.z) <= halfSize;
+}
+
+void ChunkManager::RecycleSlot(ChunkSlot &slot)
+{
+	if (IsInWindow(slot.coord))
+		return;
+	// Only reached within the grace period when the camera outruns the window margin
+	if (slot.chunk)
+		EvictChunk(slot);
+	slot.queued = false;
+}
+
+void ChunkManager::MoveWindow(glm::ivec3 center)
+{
+	glm::ivec3 shift = center - m_windowCenter;
+	m_windowCenter = center;
+	if (std::abs(shift.x) >= m_windowSize || std::abs(shift.z) >= m_windowSize)
+	{
+		for (ChunkSlot &slot : m_slots)
+			RecycleSlot(slot);
+		return;
+	}
+
+	// Only the columns and rows that scrolled out hold chunks that left, the same slots
+	// stand for the ones scrolling in on the other side
+	for (int i = 0; i < std::abs(shift.x); i++)
+	{
+		int column = Wrap(center.x + (shift.x > 0 ? m_windowSize / 2 - i : -m_windowSize / 2 + i));
+		for (int row = 0; row < m_windowSize; row++)
+			RecycleSlot(m_slots[row * m_windowSize + column]);
+	}
+	for (int i = 0; i < std::abs(shift.z); i++)
+	{
+		int row = Wrap(center.z + (shift.z > 0 ? m_windowSize / 2 - i : -m_windowSize / 2 + i));
+		for (int column = 0; column < m_windowSize; column++)
+			RecycleSlot(m_slots[row * m_windowSize + column]);
+	}
+}
+
+void ChunkManager::SetRadii(int loadRadius, int unloadRadius)
+{
+	unloadRadius = std::max(loadRadius, unloadRadius);
+	m_loadRadius = loadRadius;
+	if (unloadRadius == m_unloadRadius)
+		return;
+	m_unloadRadius = unloadRadius;
+
+	// Chunks move to their slots in the resized window, the ones that no longer fit are evicted
+	std::vector<ChunkSlot> slots = std::move(m_slots);
+	m_windowSize = (unloadRadius + m_windowMargin) * 2 + 1;
+	m_slots = std::vector<ChunkSlot>(m_windowSize * m_windowSize);
+	for (ChunkSlot &slot : slots)
+	{
+		if (slot.chunk == nullptr)
+			continue;
+		if (IsInWindow(slot.coord) == false)
+		{
+			EvictChunk(slot);
+			continue;
+		}
+		ChunkSlot &resized = GetSlot(slot.coord);
+		resized.coord = slot.coord;
+		resized.chunk = std::move(slot.chunk);
+		resized.outsideTime = slot.outsideTime;
+		resized.dirty = slot.dirty;
+	}
+	// Queued chunks are queued again for the new radius
+	m_loadQueue.clear();
+	m_queuedRadius = -1;
+}
+
+void ChunkManager::LinkNeighbours(glm::ivec3 coord, ChunkBuilder *chunk)
+{
+	for (eDIRECTION direction : s_horizontalDirections)
+	{
+		ChunkBuilder *neighbour = GetChunk(coord + s_directionOffsets[(int)direction]);
+		if (neighbour == nullptr)
+			continue;
+		chunk->SetNeighbour(direction, neighbour);
+		neighbour->SetNeighbour((eDIRECTION)((int)direction ^ 1), chunk);
+	}
+	MarkDiagonalsDirty(coord);
+}
+
+void ChunkManager::MarkDiagonalsDirty(glm::ivec3 coord)
+{
+	// Linking only dirties the chunks either side, the diagonal ones see this chunk in their corners too
+	for (glm::ivec3 offset : s_diagonalOffsets)
+	{
+		if (ChunkBuilder *diagonal = GetChunk(coord + offset))
+			diagonal->MarkHaloDirty();
+	}
+}
+
+ChunkBuilder *ChunkManager::GetChunk(glm::ivec3 coord)
+{
+	if (m_windowSize == 0)
+		return nullptr;
+	ChunkSlot &slot = GetSlot(coord);
+	return slot.chunk && slot.coord == coord ? slot.chunk.get() : nullptr;
+}
+
+ChunkBuilder *ChunkManager::GetBlockChunk(int x, int y, int z, glm::ivec3 &local)
+{
+	if (y < 0 || y >= m_chunkHeight)
+		return nullptr;
+	glm::ivec3 coord = { ToChunk(x), 0, ToChunk(z) };
+	if (m_lastChunk == nullptr || coord != m_lastCoord)
+	{
+		m_lastChunk = GetChunk(coord);
+		m_lastCoord = coord;
+	}
+	local = { x - coord.x * m_chunkSize, y, z - coord.z * m_chunkSize };
+	return m_lastChunk;
+}
+
+eBLOCKS ChunkManager::GetBlock(int x, int y, int z)
+{
+	glm::ivec3 local;
+	ChunkBuilder *chunk = GetBlockChunk(x, y, z, local);
+	return chunk ? chunk->GetBlock(local.x, local.y, local.z) : eBLOCKS::NONE;
+}
+bool ChunkManager::SetBlock(int x, int y, int z, eBLOCKS block)
+{
+	glm::ivec3 local;
+	ChunkBuilder *chunk = GetBlockChunk(x, y, z, local);
+	if (chunk == nullptr)
+		return false;
+	chunk->SetBlock(local.x, local.y, local.z, block);
+	MarkEdited(GetSlot(m_lastCoord));
+	return true;
+}
+
+void ChunkManager::GetBlocks(glm::ivec3 origin, glm::ivec3 size, eBLOCKS *blocks)
+{
+	std::fill(blocks, blocks + (size_t)size.x * size.y * size.z, eBLOCKS::NONE);
+	ForEachChunk(origin, origin + size, [&](ChunkBuilder *chunk, glm::ivec3 chunkOrigin, glm::ivec3 begin, glm::ivec3 end)
+		{
+			glm::ivec3 offset = chunkOrigin - origin;
+			for (int x = begin.x; x < end.x; x++)
+			{
+				for (int y = begin.y; y < end.y; y++)
+				{
+					eBLOCKS *row = blocks + ((size_t)(x + offset.x) * size.y + (y + offset.y)) * size.z + offset.z;
+					for (int z = begin.z; z < end.z; z++)
+						row[z] = chunk->GetBlock(x, y, z);
+				}
+			}
+		});
+}
+void ChunkManager::SetBlocks(glm::ivec3 origin, glm::ivec3 size, const eBLOCKS *blocks)
+{
+	EditBlocks(origin, origin + size, [&](int x, int y, int z, eBLOCKS block)
+		{
+			return blocks[((size_t)(x - origin.x) * size.y + (y - origin.y)) * size.z + (z - origin.z)];
+		});
+}
+
+int ChunkManager::FillBox(glm::ivec3 origin, glm::ivec3 size, eBLOCKS block)
+{
+	return EditBlocks(origin, origin + size, [block](int x, int y, int z, eBLOCKS current) { return block; });
+}
+int ChunkManager::ReplaceBox(glm::ivec3 origin, glm::ivec3 size, eBLOCKS from, eBLOCKS to)
+{
+	return EditBlocks(origin, origin + size, [from, to](int x, int y, int z, eBLOCKS current) { return current == from ? to : current; });
+}
+int ChunkManager::FillSphere(glm::ivec3 center, int radius, eBLOCKS block)
+{
+	const int radiusSquared = radius * radius;
+	return EditBlocks(center - glm::ivec3(radius), center + glm::ivec3(radius + 1), [&](int x, int y, int z, eBLOCKS current)
+		{
+			glm::ivec3 offset = glm::ivec3(x, y, z) - center;
+			return offset.x * offset.x + offset.y * offset.y + offset.z * offset.z <= radiusSquared ? block : current;
+		});
+}
+int ChunkManager::FillCylinder(glm::ivec3 base, int radius, int height, eBLOCKS block)
+{
+	const int radiusSquared = radius * radius;
+	return EditBlocks(base - glm::ivec3(radius, 0, radius), base + glm::ivec3(radius + 1, height, radius + 1), [&](int x, int y, int z, eBLOCKS current)
+		{
+			int offsetX = x - base.x;
+			int offsetZ = z - base.z;
+			return offsetX * offsetX + offsetZ * offsetZ <= radiusSquared ? block : current;
+		});
+}
+
+void ChunkManager::Copy(glm::ivec3 origin, glm::ivec3 size, BlockClipboard &clipboard)
+{
+	clipboard.size = size;
+	clipboard.blocks.resize((size_t)size.x * size.y * size.z);
+	GetBlocks(origin, size, clipboard.blocks.data());
+}
+int ChunkManager::Paste(glm::ivec3 origin, const BlockClipboard &clipboard, bool pasteAir)
+{
+	const glm::ivec3 size = clipboard.size;
+	return EditBlocks(origin, origin + size, [&](int x, int y, int z, eBLOCKS current)
+		{
+			eBLOCKS block = clipboard.blocks[((size_t)(x - origin.x) * size.y + (y - origin.y)) * size.z + (z - origin.z)];
+			return block != eBLOCKS::NONE || pasteAir ? block : current;
+		});
+}
+
+float ChunkManager::GetLoadPriority(glm::ivec3 coord)
+{
+	glm::vec3 center = GetChunkOffset(coord) + m_chunkWorldSize * 0.5f;
+	glm::vec2 offset = { center.x, center.z };
+	float distance = glm::length(offset) / m_chunkWorldSize;
+
+	// Only the horizontal view direction counts, looking straight up or down sees every side alike
+	glm::vec2 front = { m_cameraFront.x, m_cameraFront.z };
+	if (distance < 1.0f || glm::length(front) < 0.01f)
+		return distance;
+	float facing = glm::dot(offset / (distance * m_chunkWorldSize), glm::normalize(front));
+	return distance * (1.0f + m_behindWeight * (1.0f - facing) * 0.5f);
+}
+bool ChunkManager::IsInRadius(glm::ivec3 coord, int radius)
+{
+	glm::ivec3 offset = coord - m_cameraChunk;
+	return offset.x * offset.x + offset.z * offset.z <= radius * radius;
+}
+
+bool ChunkManager::IsReadyToMesh(glm::ivec3 coord, ChunkBuilder *chunk)
+{
+	// Meshing before a neighbour arrives would only be thrown away when it does,
+	// that goes for the diagonal ones the corners' ambient occlusion reads as well
+	for (eDIRECTION direction : s_horizontalDirections)
+	{
+		if (chunk->GetNeighbour(direction) == nullptr && IsInRadius(coord + s_directionOffsets[(int)direction], GetActiveRadius()))
+			return false;
+	}
+	for (glm::ivec3 offset : s_diagonalOffsets)
+	{
+		if (GetChunk(coord + offset) == nullptr && IsInRadius(coord + offset, GetActiveRadius()))
+			return false;
+	}
+	return true;
+}
+
+bool ChunkManager::IsInFrustum(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+{
+	// Outside when the corner furthest along a plane's normal is behind it
+	for (const glm::vec4 &plane : m_frustum)
+	{
+		glm::vec3 corner = {
+			plane.x >= 0.0f ? boundsMax.x : boundsMin.x,
+			plane.y >= 0.0f ? boundsMax.y : boundsMin.y,
+			plane.z >= 0.0f ? boundsMax.z : boundsMin.z };
+		if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+void ChunkManager::UpdateMemory(float deltaTime, MemoryBudget &memory)
+{
+	if (memory.IsOverCapacity() == false)
+	{
+		// Once well under the budget again the radius grows back a ring at a time
+		m_pressureTime += deltaTime;
+		if (m_pressureRadius < m_loadRadius && m_pressureTime >= m_regrowDelay && memory.GetTotal() < memory.GetCapacity() * m_regrowFraction)
+		{
+			if (++m_pressureRadius >= m_loadRadius)
+				m_pressureRadius = std::numeric_limits<int>::max();
+			m_pressureTime = 0.0f;
+		}
+		return;
+	}
+	m_pressureTime = 0.0f;
+
+	// Retired chunks free their memory within the next updates' budgets, it already counts as given back
+	size_t retiring = 0;
+	for (std::unique_ptr<ChunkBuilder> &chunk : m_retired)
+		retiring += chunk->GetMemoryUsage();
+	auto overCapacity = [&memory, &retiring]
+		{
+			return memory.GetTotal() > memory.GetCapacity() + retiring;
+		};
+
+	// Cached meshes only save meshing again, they go before any chunk
+	MeshCache *cache = MeshCache::Get();
+	if (cache && overCapacity())
+		cache->Trim(memory.GetTotal() - memory.GetCapacity() - retiring);
+
+	// Then parked chunks, compressed while that's enough and retired when it isn't,
+	// the least recently parked first
+	for (auto it = m_parked.rbegin(); it != m_parked.rend() && overCapacity(); ++it)
+		(*it)->CompressBlocks();
+	while (m_parked.empty() == false && overCapacity())
+	{
+		retiring += m_parked.back()->GetMemoryUsage();
+		m_parkedChunks.erase(m_parked.back()->GetChunkCoord());
+		m_retired.push_back(std::move(m_parked.back()));
+		m_parked.pop_back();
+	}
+
+	// Then loaded chunks, the farthest ring at a time, and the radius shrinks so they aren't loaded again.
+	// They skip parking, it would only keep their blocks.
+	while (overCapacity() && m_chunkCount > 1)
+	{
+		int farthest = 0;
+		for (ChunkSlot &slot : m_slots)
+		{
+			if (slot.chunk == nullptr)
+				continue;
+			glm::ivec3 offset = slot.coord - m_cameraChunk;
+			farthest = std::max(farthest, offset.x * offset.x + offset.z * offset.z);
+		}
+		int radius = (int)std::ceil(std::sqrt((float)farthest)) - 1;
+		m_pressureRadius = std::min(m_pressureRadius, std::max(radius, 0));
+		for (ChunkSlot &slot : m_slots)
+		{
+			if (slot.chunk == nullptr || IsInRadius(slot.coord, m_pressureRadius))
+				continue;
+			retiring += slot.chunk->GetMemoryUsage();
+			EvictChunk(slot, false);
+			slot.queued = false;
+		}
+	}
+}
+
+void ChunkManager::SetMeshFormat(eMESH_FORMAT format)
+{
+	m_meshFormat = format;
+	for (ChunkSlot &slot : m_slots)
+	{
+		if (slot.chunk)
+			slot.chunk->SetMeshFormat(format);
+	}
+}
+
+void ChunkManager::Draw()
+{
+	m_visible.clear();
+	for (ChunkSlot &slot : m_slots)
+	{
+		if (slot.chunk == nullptr)
+			continue;
+		// Blocks are centered on their position, so a chunk starts a block's half size before it
+		glm::vec3 offset = GetChunkOffset(slot.coord);
+		glm::vec3 boundsMin = offset - glm::vec3(1.0f);
+		glm::vec3 boundsMax = boundsMin + glm::vec3(m_chunkWorldSize);
+		if (IsInFrustum(boundsMin, boundsMax) == false)
+			continue;
+		glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+		m_visible.push_back({ glm::dot(center, center), offset, slot.chunk.get() });
+	}
+	std::sort(m_visible.begin(), m_visible.end(), [](const VisibleChunk &a, const VisibleChunk &b) { return a.distance < b.distance; });
+
+	// Opaque first, then alpha tested cutout, then translucent blended over both without writing depth
+	for (VisibleChunk &visible : m_visible)
+		visible.chunk->Draw(visible.offset, eRENDER_PASS::SOLID);
+	for (VisibleChunk &visible : m_visible)
+		visible.chunk->Draw(visible.offset, eRENDER_PASS::CUTOUT);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDepthMask(GL_FALSE);
+	for (auto it = m_visible.rbegin(); it != m_visible.rend(); ++it)
+		it->chunk->Draw(it->offset, eRENDER_PASS::TRANSLUCENT);
+	glDepthMask(GL_TRUE);
+	glDisable(GL_BLEND);
+}
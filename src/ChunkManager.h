@@ -5,20 +5,326 @@
 
 #include "ChunkBuilder.h"
 
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <list>
+#include <span>
+#include <unordered_map>
+
 struct Camera;
+class MemoryBudget;
+class Shader;
+class Texture;
+
+// What has changed about a chunk, as bits of ChunkEvent::dirty
+enum class eCHUNK_DIRTY
+{
+	// Blocks were edited
+	BLOCKS = 0,
+	// Light has to be worked out again, set along with blocks
+	LIGHT,
+	// A mesh was rebuilt
+	MESH,
+	// Has changes that haven't been saved, set along with blocks
+	SAVE,
+	DIRTY_MAX
+};
+
+enum class eCHUNK_EVENT
+{
+	LOADED = 0,
+	CHANGED,
+	UNLOADED,
+	EVENT_MAX
+};
+
+struct ChunkEvent
+{
+	eCHUNK_EVENT type;
+	glm::ivec3 coord;
+	// eCHUNK_DIRTY bits that changed, for an unload the ones it still had pending
+	unsigned int dirty;
+	// Only valid during the dispatch, nullptr for unloads (and loads that have unloaded again)
+	ChunkBuilder *chunk;
+};
 
+// Blocks copied out of the world, indexed [x][y][z]
+struct BlockClipboard
+{
+	glm::ivec3 size = { 0, 0, 0 };
+	std::vector<eBLOCKS> blocks;
+};
+
+// Owns every chunk of the world, streaming them in and out around the camera
+// and meshing them within a time budget each update.
 class ChunkManager
 {
 public:
-	ChunkManager();
+	ChunkManager(Shader *shader, Shader *faceShader, Shader *pullShader, Texture *texture);
 	~ChunkManager();
 
 	void Update(float deltaTime, Camera& camera);
+	// Draws every chunk in view, pass by pass. Solid and cutout chunks front to back so
+	// near geometry hides what's behind it, translucent chunks back to front.
+	void Draw();
+
+	// Switches every chunk, and the ones loaded after, to a mesh format.
+	void SetMeshFormat(eMESH_FORMAT format);
+	inline eMESH_FORMAT GetMeshFormat() { return m_meshFormat; }
+
+	// Most microseconds an update spends integrating chunks (meshing and uploading them,
+	// generating new ones and freeing old ones), the budget shrinks below it while frames are slow.
+	inline void SetFrameBudget(float microseconds) { m_maxBudget = microseconds; m_budget = std::min(m_budget, microseconds); }
+	inline float GetFrameBudget() { return m_budget; }
+	// Seconds a frame should take, the budget shrinks while frames are slower than it and grows while they're faster
+	inline void SetTargetFrameTime(float seconds) { m_targetFrameTime = seconds; }
+	inline float GetTargetFrameTime() { return m_targetFrameTime; }
+
+	// Radii in chunks around the camera that chunks are loaded within and evicted past,
+	// resizing the window to fit the unload radius. The unload radius is at least the load radius.
+	void SetRadii(int loadRadius, int unloadRadius);
+	inline int GetLoadRadius() { return m_loadRadius; }
+	inline int GetUnloadRadius() { return m_unloadRadius; }
+
+	// Seconds a chunk has to stay past the unload radius before it is evicted, so crossing back and forth
+	// over a border keeps it loaded
+	inline void SetUnloadGrace(float seconds) { m_unloadGrace = seconds; }
+	// Evicted chunks kept to come back without generating, 0 destroys them straight away
+	inline void SetParkCapacity(size_t chunks) { m_parkCapacity = chunks; }
+	inline size_t GetParkedCount() { return m_parked.size(); }
+
+	// Listeners are called at the end of every update that had events, with all of them in the order
+	// they happened, changes as one event per chunk. Returns an id to unsubscribe with. Listeners can
+	// edit the world, but not subscribe or unsubscribe while they are being called.
+	typedef std::function<void(std::span<const ChunkEvent> events)> ChunkListener;
+	int Subscribe(ChunkListener listener);
+	void Unsubscribe(int id);
+
+	ChunkBuilder *GetChunk(glm::ivec3 coord);
+	inline size_t GetChunkCount() { return m_chunkCount; }
+
+	// World block access, in blocks from the world origin. Blocks in chunks that aren't loaded read
+	// as air and can't be set. The last chunk accessed is remembered, so walking over nearby blocks
+	// rarely has to find a chunk again.
+	eBLOCKS GetBlock(int x, int y, int z);
+	bool SetBlock(int x, int y, int z, eBLOCKS block);
+	// Copies the box of size blocks starting at origin to or from blocks, indexed [x][y][z] like a chunk's blocks.
+	// Works a chunk at a time rather than a block at a time.
+	void GetBlocks(glm::ivec3 origin, glm::ivec3 size, eBLOCKS *blocks);
+	void SetBlocks(glm::ivec3 origin, glm::ivec3 size, const eBLOCKS *blocks);
+
+	// Bulk edits, returning how many blocks changed. They write each chunk's blocks directly and mark
+	// every chunk they change dirty once, its meshes are rebuilt together on a later update.
+	int FillBox(glm::ivec3 origin, glm::ivec3 size, eBLOCKS block);
+	// Only blocks that are currently from are changed
+	int ReplaceBox(glm::ivec3 origin, glm::ivec3 size, eBLOCKS from, eBLOCKS to);
+	int FillSphere(glm::ivec3 center, int radius, eBLOCKS block);
+	// Upright cylinder standing on base
+	int FillCylinder(glm::ivec3 base, int radius, int height, eBLOCKS block);
+	void Copy(glm::ivec3 origin, glm::ivec3 size, BlockClipboard &clipboard);
+	// Air in the clipboard leaves the world's blocks alone unless pasteAir is set
+	int Paste(glm::ivec3 origin, const BlockClipboard &clipboard, bool pasteAir = true);
 
 private:
+	struct ChunkSlot
+	{
+		// Coordinate the slot holds, or is queued to load
+		glm::ivec3 coord = { 0, 0, 0 };
+		std::unique_ptr<ChunkBuilder> chunk;
+		bool queued = false;
+		// Seconds the chunk has been past the unload radius
+		float outsideTime = 0.0f;
+		// eCHUNK_DIRTY bits set since the last dispatch
+		unsigned char dirty = 0;
+	};
+	struct CoordHash
+	{
+		size_t operator()(const glm::ivec3 &coord) const;
+	};
+
+	inline ChunkSlot &GetSlot(glm::ivec3 coord) { return m_slots[Wrap(coord.z) * m_windowSize + Wrap(coord.x)]; }
+	inline int Wrap(int value) { int wrapped = value % m_windowSize; return wrapped < 0 ? wrapped + m_windowSize : wrapped; }
+	bool IsInWindow(glm::ivec3 coord);
+	// Frees the slot when what it holds has left the window
+	void RecycleSlot(ChunkSlot &slot);
+	void PlaceChunk(glm::ivec3 coord, std::unique_ptr<ChunkBuilder> chunk);
+	// Takes the chunk out of its slot, raising its unload event
+	std::unique_ptr<ChunkBuilder> UnloadChunk(ChunkSlot &slot);
+	// Unlinks the slot's chunk and parks it, or retires it when parking is off
+	void EvictChunk(ChunkSlot &slot, bool park = true);
+	void MoveWindow(glm::ivec3 center);
+
+	void QueueChunks();
+	// Generates the next batch of queued chunks in parallel, returning how many were loaded
+	int LoadChunks();
+	void LinkNeighbours(glm::ivec3 coord, ChunkBuilder *chunk);
+	void MarkDiagonalsDirty(glm::ivec3 coord);
+	void MarkChunkDirty(ChunkSlot &slot, eCHUNK_DIRTY flag);
+	void MarkEdited(ChunkSlot &slot);
+	void DispatchEvents();
+
+	// While over the memory budget (less what retired chunks are about to free) trims the MeshCache,
+	// compresses parked chunks, then retires them, then retires the farthest ring and holds the radius in.
+	// Grows it back once well under.
+	void UpdateMemory(float deltaTime, MemoryBudget &memory);
+	// Radius chunks are loaded within, the load radius unless memory pressure has held it in
+	inline int GetActiveRadius() { return std::min(m_loadRadius, m_pressureRadius); }
+
+	inline int ToChunk(int block) { return block >= 0 ? block / m_chunkSize : (block + 1) / m_chunkSize - 1; }
+	// Chunk holding a world block, and the block's position in it
+	ChunkBuilder *GetBlockChunk(int x, int y, int z, glm::ivec3 &local);
+	// Calls visit(chunk, origin, begin, end) for every loaded chunk overlapping the blocks min up to max,
+	// with the chunk's first block in world blocks and the overlap in chunk local blocks (end exclusive)
+	template<typename Visit>
+	void ForEachChunk(glm::ivec3 min, glm::ivec3 max, const Visit &visit)
+	{
+		min.y = std::max(min.y, 0);
+		max.y = std::min(max.y, m_chunkHeight);
+		if (min.x >= max.x || min.y >= max.y || min.z >= max.z)
+			return;
+		for (int chunkZ = ToChunk(min.z); chunkZ <= ToChunk(max.z - 1); chunkZ++)
+		{
+			for (int chunkX = ToChunk(min.x); chunkX <= ToChunk(max.x - 1); chunkX++)
+			{
+				ChunkBuilder *chunk = GetChunk({ chunkX, 0, chunkZ });
+				if (chunk == nullptr)
+					continue;
+				glm::ivec3 origin = { chunkX * m_chunkSize, 0, chunkZ * m_chunkSize };
+				glm::ivec3 begin = glm::max(min - origin, glm::ivec3(0));
+				glm::ivec3 end = glm::min(max - origin, glm::ivec3(m_chunkSize, m_chunkHeight, m_chunkSize));
+				visit(chunk, origin, begin, end);
+			}
+		}
+	}
+	// Sets every block from min up to max to edit(x, y, z, block) in world blocks, a chunk at a time
+	template<typename Edit>
+	int EditBlocks(glm::ivec3 min, glm::ivec3 max, const Edit &edit)
+	{
+		int changed = 0;
+		ForEachChunk(min, max, [&](ChunkBuilder *chunk, glm::ivec3 origin, glm::ivec3 begin, glm::ivec3 end)
+			{
+				int chunkChanged = chunk->EditRegion(begin, end, [&](int x, int y, int z, eBLOCKS block)
+					{
+						return edit(origin.x + x, y, origin.z + z, block);
+					});
+				if (chunkChanged > 0)
+					MarkEdited(GetSlot(chunk->GetChunkCoord()));
+				changed += chunkChanged;
+			});
+		return changed;
+	}
+
+	// Lower loads sooner, the distance in chunks stretched for chunks away from the view direction
+	float GetLoadPriority(glm::ivec3 coord);
+	bool IsInRadius(glm::ivec3 coord, int radius);
+	// Once the chunks its halo reads are loaded, or never will be
+	bool IsReadyToMesh(glm::ivec3 coord, ChunkBuilder *chunk);
+	bool IsInFrustum(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax);
+	// Chunk origin relative to the camera, worked out in double so it's exact at any distance
+	inline glm::vec3 GetChunkOffset(glm::ivec3 coord) { return glm::vec3(glm::dvec3(coord) * (double)m_chunkWorldSize - m_cameraPos); }
 
 private:
-	glm::vec3 m_cameraPos;
-	glm::mat4 m_cameraView;
+	glm::dvec3 m_cameraPos;
+	glm::vec3 m_cameraFront;
+	// Planes as (normal, distance) pointing into the view volume, relative to the camera
+	glm::vec4 m_frustum[6];
+	glm::ivec3 m_cameraChunk = { 0, 0, 0 };
+
+	// m_windowSize squared slots centered on m_windowCenter, sized to fit the unload radius.
+	// Chunks are indexed by coordinate modulo the window size, so when the camera crosses into another
+	// chunk only the rows and columns that scrolled out are evicted, and their slots reused for the new side.
+	std::vector<ChunkSlot> m_slots;
+	int m_windowSize = 0;
+	// Chunks the window reaches past the unload radius. A chunk that crosses the radius keeps its slot
+	// this much further, so it's the grace period that unloads it rather than the window scrolling on.
+	const int m_windowMargin = 2;
+	glm::ivec3 m_windowCenter = { 0, 0, 0 };
+	size_t m_chunkCount = 0;
+
+	// Min-heap of chunks waiting to be loaded. Priorities are only worked out again lazily when an
+	// entry reaches the top after the camera has moved or turned (its epoch is behind m_loadEpoch),
+	// so the queue is never rebuilt as a whole.
+	struct LoadRequest
+	{
+		float priority;
+		unsigned int epoch;
+		glm::ivec3 coord;
+
+		bool operator<(const LoadRequest &other) const { return priority > other.priority; }
+	};
+	std::vector<LoadRequest> m_loadQueue;
+	unsigned int m_loadEpoch = 0;
+	// Camera the current epoch's priorities were worked out for, and how far it can stray
+	glm::dvec3 m_epochPos = { 0.0, 0.0, 0.0 };
+	glm::vec3 m_epochFront = { 0.0f, 0.0f, -1.0f };
+	const float m_epochDistance = 16.0f;
+	const float m_epochAngle = 0.966f; // cos 15 degrees
+	// Radius and camera chunk the queue was last filled for
+	glm::ivec3 m_queuedChunk = { 0, 0, 0 };
+	int m_queuedRadius = -1;
+	// How much a chunk straight behind the camera is delayed, times its distance
+	const float m_behindWeight = 2.0f;
+	// Chunks in view this frame, nearest first
+	struct VisibleChunk
+	{
+		float distance;
+		glm::vec3 offset;
+		ChunkBuilder *chunk;
+	};
+	std::vector<VisibleChunk> m_visible;
+	// Chunks with meshes to build this update, by load priority
+	std::vector<std::pair<float, ChunkBuilder *>> m_meshQueue;
+	// Unlinked chunks waiting to be destroyed
+	std::vector<std::unique_ptr<ChunkBuilder>> m_retired;
+	// Evicted chunks without their meshes, most recently parked first, up to m_parkCapacity.
+	// They come back from here without generating.
+	std::list<std::unique_ptr<ChunkBuilder>> m_parked;
+	std::unordered_map<glm::ivec3, std::list<std::unique_ptr<ChunkBuilder>>::iterator, CoordHash> m_parkedChunks;
+	size_t m_parkCapacity = 64;
+	float m_unloadGrace = 5.0f;
+
+	// Events and changed chunks waiting for the end of the update
+	std::vector<ChunkEvent> m_events;
+	std::vector<ChunkEvent> m_dispatching;
+	std::vector<glm::ivec3> m_dirtyChunks;
+	std::vector<std::pair<int, ChunkListener>> m_listeners;
+	int m_lastListener = 0;
+
+	float m_maxBudget = 4000.0f;
+	float m_budget = 4000.0f;
+	const float m_minBudget = 500.0f;
+	float m_targetFrameTime = 1.0f / 60.0f;
+	// Frame time averaged over recent frames, so vsync jitter and single slow frames don't move the budget
+	float m_frameTime = 1.0f / 60.0f;
+	const float m_frameTimeSmoothing = 0.1f;
+	// Fraction past the target a frame can take and still count as on time
+	const float m_frameHeadroom = 0.1f;
+	// Most the budget changes by in an update, as a fraction of itself
+	const float m_maxBudgetStep = 0.5f;
+
+	eMESH_FORMAT m_meshFormat = eMESH_FORMAT::VERTICES;
+	int m_loadRadius = 0;
+	int m_unloadRadius = 0;
+	// Load radius held in by memory pressure, and how far under the budget (and for how long)
+	// memory has to be to grow it again
+	int m_pressureRadius = std::numeric_limits<int>::max();
+	float m_pressureTime = 0.0f;
+	const float m_regrowFraction = 0.75f;
+	const float m_regrowDelay = 2.0f;
+
+	// Chunk size in blocks and world units, chunks are a single layer tall
+	const int m_chunkSize = 32;
+	const int m_chunkHeight = 32;
+	const float m_chunkWorldSize = 64.0f;
+
+	// Chunk the last block access went to
+	ChunkBuilder *m_lastChunk = nullptr;
+	glm::ivec3 m_lastCoord = { 0, 0, 0 };
+
+	Shader *m_shader;
+	Shader *m_faceShader;
+	Shader *m_pullShader;
+	Texture *m_texture;
 
 };
@@ -0,0 +1,400 @@
+#include "ChunkMesh.h"
+
+#include "FaceBuffer.h"
+#include "MemoryBudget.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+
+// Writes data into the buffer in place, only reallocating its storage (with headroom) when it doesn't fit
+static void UpdateBuffer(GLenum target, unsigned int buffer, size_t &capacity, size_t size, const void *data)
+{
+	glBindBuffer(target, buffer);
+	if (size > capacity)
+	{
+		capacity = size + size / 2;
+		glBufferData(target, capacity, nullptr, GL_DYNAMIC_DRAW);
+	}
+	if (data && size > 0)
+		glBufferSubData(target, 0, size, data);
+}
+
+ChunkMesh::ChunkMesh()
+{ }
+ChunkMesh::~ChunkMesh()
+{
+	Destroy();
+}
+
+unsigned int ChunkMesh::GetElementTarget() const
+{
+	return m_format == eMESH_FORMAT::PACKED_FACES ? GL_ARRAY_BUFFER : GL_ELEMENT_ARRAY_BUFFER;
+}
+
+void ChunkMesh::Upload(const MeshBuilder &builder)
+{
+	// Attribute layouts differ between formats, start over when switching
+	if (HasStorage() && builder.GetFormat() != m_format)
+		Destroy();
+	m_format = builder.GetFormat();
+
+	// An emptied mesh (a section that was dug out) gives its storage back rather than keeping it
+	// for faces it may never get again
+	if (builder.IsEmpty())
+	{
+		Destroy();
+		return;
+	}
+
+	m_elementCount = (int)builder.GetElementCount();
+	for (int pass = 0; pass < (int)eRENDER_PASS::PASS_MAX; pass++)
+	{
+		m_passCounts[pass] = 0;
+		for (int i = 0; i < (int)eDIRECTION::DIRECTION_MAX; i++)
+			m_passCounts[pass] += (int)builder.GetElements((eRENDER_PASS)pass, (eDIRECTION)i).size();
+	}
+
+	if (m_format == eMESH_FORMAT::PULLED_FACES)
+	{
+		// Direct builds already wrote their faces into the slice from MapFaces
+		const int translucentCount = m_passCounts[(int)eRENDER_PASS::TRANSLUCENT];
+		if (builder.IsDirect() == false)
+			ReserveSlice(m_slice, m_elementCount - translucentCount);
+		ReserveSlice(m_translucentSlice, translucentCount);
+	}
+
+	// Reuse the buffers when remeshing
+	if (m_format != eMESH_FORMAT::PULLED_FACES && m_VAO == 0)
+	{
+		m_bufferSize = 4;
+		glGenVertexArrays(1, &m_VAO);
+		m_VBO = new unsigned int[m_bufferSize];
+		glGenBuffers(m_bufferSize, m_VBO);
+		glGenBuffers(1, &m_EBO);
+	}
+
+	if (m_format == eMESH_FORMAT::VERTICES)
+	{
+		glBindVertexArray(m_VAO);
+		// Vertices
+		UpdateBuffer(GL_ARRAY_BUFFER, m_VBO[0], m_bufferCapacity[0], builder.GetVertices().size() * sizeof(float), builder.GetVertices().data());
+		// Normals
+		UpdateBuffer(GL_ARRAY_BUFFER, m_VBO[1], m_bufferCapacity[1], builder.GetNormals().size() * sizeof(float), builder.GetNormals().data());
+		// Texture Layers
+		UpdateBuffer(GL_ARRAY_BUFFER, m_VBO[2], m_bufferCapacity[2], builder.GetLayers().size() * sizeof(unsigned int), builder.GetLayers().data());
+		// Colors
+		UpdateBuffer(GL_ARRAY_BUFFER, m_VBO[3], m_bufferCapacity[3], builder.GetColors().size() * sizeof(float), builder.GetColors().data());
+		// Indices
+		UpdateBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO, m_indexCapacity, m_elementCount * sizeof(unsigned int), nullptr);
+	}
+	else if (m_format == eMESH_FORMAT::PACKED_FACES)
+	{
+		glBindVertexArray(m_VAO);
+		// Packed faces, one per instance
+		UpdateBuffer(GL_ARRAY_BUFFER, m_VBO[0], m_bufferCapacity[0], m_elementCount * sizeof(unsigned int), nullptr);
+	}
+	if (m_VAO != 0)
+		SetupAttributes();
+
+	// Solid and cutout directions each written into their own range
+	int offset = 0;
+	for (int pass = 0; pass < (int)eRENDER_PASS::TRANSLUCENT; pass++)
+	{
+		for (int i = 0; i < (int)eDIRECTION::DIRECTION_MAX; i++)
+		{
+			std::span<const unsigned int> elements = builder.GetElements((eRENDER_PASS)pass, (eDIRECTION)i);
+			m_rangeOffsets[pass][i] = offset;
+			m_rangeCounts[pass][i] = (int)elements.size();
+			if (builder.IsDirect() == false)
+				WriteElements((eRENDER_PASS)pass, offset, elements.data(), (int)elements.size());
+			offset += (int)elements.size();
+		}
+	}
+
+	// Translucent directions are merged into the last range, which gets sorted before drawing
+	const int translucent = (int)eRENDER_PASS::TRANSLUCENT;
+	if (m_format == eMESH_FORMAT::PULLED_FACES)
+		offset = 0;
+	m_translucentElements.clear();
+	m_translucentCenters.clear();
+	for (int i = 0; i < (int)eDIRECTION::DIRECTION_MAX; i++)
+	{
+		std::span<const unsigned int> elements = builder.GetElements(eRENDER_PASS::TRANSLUCENT, (eDIRECTION)i);
+		m_translucentElements.insert(m_translucentElements.end(), elements.begin(), elements.end());
+		m_rangeOffsets[translucent][i] = offset;
+		m_rangeCounts[translucent][i] = 0;
+	}
+	m_rangeCounts[translucent][0] = (int)m_translucentElements.size();
+
+	if (m_format == eMESH_FORMAT::VERTICES)
+	{
+		// The first triangle of a quad always starts and ends on opposite corners
+		const std::vector<float> &vertices = builder.GetVertices();
+		for (size_t quad = 0; quad < m_translucentElements.size(); quad += 6)
+		{
+			unsigned int a = m_translucentElements[quad] * 3;
+			unsigned int c = m_translucentElements[quad + 2] * 3;
+			m_translucentCenters.push_back({
+				(vertices[a] + vertices[c]) * 0.5f,
+				(vertices[a + 1] + vertices[c + 1]) * 0.5f,
+				(vertices[a + 2] + vertices[c + 2]) * 0.5f });
+		}
+	}
+	else
+	{
+		// Block center pushed out to the face along its direction
+		const float scale = (float)builder.GetScale();
+		for (unsigned int face : m_translucentElements)
+		{
+			glm::ivec3 block = MeshBuilder::UnpackFacePosition(face);
+			int direction = (int)MeshBuilder::UnpackFaceDirection(face);
+			glm::vec3 center = {
+				(block.x * 2.0f + 1.0f) * scale - 1.0f,
+				(block.y * 2.0f + 1.0f) * scale - 1.0f,
+				(block.z * 2.0f + 1.0f) * scale - 1.0f };
+			center[direction / 2] += (direction % 2 == 0 ? -1.0f : 1.0f) * scale;
+			m_translucentCenters.push_back(center);
+		}
+	}
+	WriteElements(eRENDER_PASS::TRANSLUCENT, offset, m_translucentElements.data(), (int)m_translucentElements.size());
+	m_sortDirty = true;
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+	TrackMemory();
+}
+
+unsigned int *ChunkMesh::MapFaces(const MeshCounts &counts, eMESH_FORMAT format)
+{
+	FaceBuffer *faceBuffer = FaceBuffer::Get();
+	if (format != eMESH_FORMAT::PULLED_FACES || faceBuffer == nullptr || faceBuffer->IsPersistent() == false)
+		return nullptr;
+
+	if (HasStorage() && format != m_format)
+		Destroy();
+	m_format = format;
+
+	const int count = counts.GetTotal() - counts.GetPassTotal(eRENDER_PASS::TRANSLUCENT);
+	ReserveSlice(m_slice, count);
+	TrackMemory();
+	if (count == 0)
+		return nullptr;
+	return faceBuffer->Map(m_slice.offset);
+}
+
+void ChunkMesh::ReserveSlice(Slice &slice, int count)
+{
+	FaceBuffer *faceBuffer = FaceBuffer::Get();
+	// A persistently mapped slice may still be read by frames in flight, always write a fresh one
+	if (faceBuffer->IsPersistent())
+	{
+		FreeSlice(slice);
+		if (count > 0)
+			slice = { faceBuffer->Allocate(count), count };
+		return;
+	}
+	if (count <= slice.count)
+		return;
+
+	// Same headroom as the other formats' buffers, so small edits keep their slice
+	FreeSlice(slice);
+	slice.count = count + count / 2;
+	slice.offset = faceBuffer->Allocate(slice.count);
+}
+
+void ChunkMesh::FreeSlice(Slice &slice)
+{
+	if (slice.count > 0 && FaceBuffer::Get())
+		FaceBuffer::Get()->Free(slice.offset, slice.count);
+	slice = { };
+}
+
+void ChunkMesh::WriteElements(eRENDER_PASS pass, int offset, const unsigned int *elements, int count)
+{
+	if (count == 0)
+		return;
+
+	if (m_format == eMESH_FORMAT::PULLED_FACES)
+	{
+		const Slice &slice = pass == eRENDER_PASS::TRANSLUCENT ? m_translucentSlice : m_slice;
+		FaceBuffer::Get()->Write(slice.offset + offset, elements, count);
+		return;
+	}
+
+	glBindVertexArray(m_VAO);
+	glBindBuffer(GetElementTarget(), GetElementBuffer());
+	glBufferSubData(GetElementTarget(), offset * sizeof(unsigned int), count * sizeof(unsigned int), elements);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+void ChunkMesh::SetupAttributes()
+{
+	if (m_format == eMESH_FORMAT::PACKED_FACES)
+	{
+		// Offset is set per draw to select the range
+		glBindBuffer(GL_ARRAY_BUFFER, m_VBO[0]);
+		glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, sizeof(unsigned int), (void *)0);
+		glVertexAttribDivisor(0, 1);
+		glEnableVertexAttribArray(0);
+		return;
+	}
+
+	// Vertices
+	glBindBuffer(GL_ARRAY_BUFFER, m_VBO[0]);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+	glEnableVertexAttribArray(0);
+	// Normals
+	glBindBuffer(GL_ARRAY_BUFFER, m_VBO[1]);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+	glEnableVertexAttribArray(1);
+	// Texture Layers
+	glBindBuffer(GL_ARRAY_BUFFER, m_VBO[2]);
+	glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(unsigned int), (void *)0);
+	glEnableVertexAttribArray(2);
+	// Colors
+	glBindBuffer(GL_ARRAY_BUFFER, m_VBO[3]);
+	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)0);
+	glEnableVertexAttribArray(3);
+}
+
+void ChunkMesh::SortTranslucent(const glm::vec3 &cameraPosition)
+{
+	if (m_translucentCenters.empty())
+		return;
+	glm::vec3 moved = cameraPosition - m_lastSortPosition;
+	if (m_sortDirty == false && glm::dot(moved, moved) < m_sortThreshold * m_sortThreshold)
+		return;
+	m_lastSortPosition = cameraPosition;
+	m_sortDirty = false;
+
+	// Farthest faces first
+	m_sortOrder.resize(m_translucentCenters.size());
+	for (unsigned int i = 0; i < m_sortOrder.size(); i++)
+		m_sortOrder[i] = i;
+	std::sort(m_sortOrder.begin(), m_sortOrder.end(), [&](unsigned int a, unsigned int b)
+	{
+		glm::vec3 da = m_translucentCenters[a] - cameraPosition;
+		glm::vec3 db = m_translucentCenters[b] - cameraPosition;
+		return glm::dot(da, da) > glm::dot(db, db);
+	});
+
+	const int elementsPerFace = GetElementsPerFace();
+	m_sortedElements.resize(m_translucentElements.size());
+	for (size_t i = 0; i < m_sortOrder.size(); i++)
+	{
+		for (int j = 0; j < elementsPerFace; j++)
+			m_sortedElements[i * elementsPerFace + j] = m_translucentElements[m_sortOrder[i] * elementsPerFace + j];
+	}
+
+	const int translucent = (int)eRENDER_PASS::TRANSLUCENT;
+	if (m_format == eMESH_FORMAT::PULLED_FACES)
+		ReserveSlice(m_translucentSlice, (int)m_sortedElements.size());
+	WriteElements(eRENDER_PASS::TRANSLUCENT, m_rangeOffsets[translucent][0], m_sortedElements.data(), (int)m_sortedElements.size());
+	TrackMemory();
+}
+
+void ChunkMesh::TrackMemory()
+{
+	size_t meshData = m_translucentElements.capacity() * sizeof(unsigned int) + m_translucentCenters.capacity() * sizeof(glm::vec3)
+		+ m_sortOrder.capacity() * sizeof(unsigned int) + m_sortedElements.capacity() * sizeof(unsigned int);
+	size_t buffers = m_indexCapacity + (size_t)(m_slice.count + m_translucentSlice.count) * sizeof(unsigned int);
+	for (int i = 0; i < 4; i++)
+		buffers += m_bufferCapacity[i];
+
+	MemoryBudget::Track(eMEMORY::MESH_DATA, (int64_t)meshData - (int64_t)m_trackedMeshData);
+	MemoryBudget::Track(eMEMORY::GPU_BUFFERS, (int64_t)buffers - (int64_t)m_trackedBuffers);
+	m_trackedMeshData = meshData;
+	m_trackedBuffers = buffers;
+}
+
+void ChunkMesh::Draw(eRENDER_PASS pass, const bool visible[(int)eDIRECTION::DIRECTION_MAX])
+{
+	if (m_passCounts[(int)pass] == 0)
+		return;
+
+	GLsizei counts[(int)eDIRECTION::DIRECTION_MAX];
+	int offsets[(int)eDIRECTION::DIRECTION_MAX];
+	GLsizei drawCount = 0;
+	for (int i = 0; i < (int)eDIRECTION::DIRECTION_MAX; i++)
+	{
+		if (m_rangeCounts[(int)pass][i] == 0)
+			continue;
+		if (pass != eRENDER_PASS::TRANSLUCENT && visible[i] == false)
+			continue;
+		counts[drawCount] = m_rangeCounts[(int)pass][i];
+		offsets[drawCount] = m_rangeOffsets[(int)pass][i];
+		drawCount++;
+	}
+	if (drawCount == 0)
+		return;
+
+	if (m_format == eMESH_FORMAT::PULLED_FACES)
+	{
+		// No attributes, the first vertex of each range is its first face in the FaceBuffer times 6
+		const Slice &slice = pass == eRENDER_PASS::TRANSLUCENT ? m_translucentSlice : m_slice;
+		GLint firsts[(int)eDIRECTION::DIRECTION_MAX];
+		for (int i = 0; i < drawCount; i++)
+		{
+			firsts[i] = (slice.offset + offsets[i]) * 6;
+			counts[i] *= 6;
+		}
+		glMultiDrawArrays(GL_TRIANGLES, firsts, counts, drawCount);
+		return;
+	}
+
+	glBindVertexArray(m_VAO);
+	if (m_format == eMESH_FORMAT::PACKED_FACES)
+	{
+		// A unit quad per instance, the instance attribute is pointed at each range in turn
+		glBindBuffer(GL_ARRAY_BUFFER, m_VBO[0]);
+		for (int i = 0; i < drawCount; i++)
+		{
+			glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, sizeof(unsigned int), (void *)(offsets[i] * sizeof(unsigned int)));
+			glDrawArraysInstanced(GL_TRIANGLES, 0, 6, counts[i]);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	else
+	{
+		const void *indexOffsets[(int)eDIRECTION::DIRECTION_MAX];
+		for (int i = 0; i < drawCount; i++)
+			indexOffsets[i] = (const void *)(offsets[i] * sizeof(unsigned int));
+		glMultiDrawElements(GL_TRIANGLES, counts, GL_UNSIGNED_INT, indexOffsets, drawCount);
+	}
+	glBindVertexArray(0);
+}
+
+void ChunkMesh::Destroy()
+{
+	// The sorting copies are only needed while there is a mesh to sort
+	std::vector<unsigned int>().swap(m_translucentElements);
+	std::vector<glm::vec3>().swap(m_translucentCenters);
+	std::vector<unsigned int>().swap(m_sortOrder);
+	std::vector<unsigned int>().swap(m_sortedElements);
+
+	m_elementCount = 0;
+	for (int pass = 0; pass < (int)eRENDER_PASS::PASS_MAX; pass++)
+		m_passCounts[pass] = 0;
+	FreeSlice(m_slice);
+	FreeSlice(m_translucentSlice);
+	if (m_VAO == 0)
+	{
+		TrackMemory();
+		return;
+	}
+
+	glDeleteBuffers(1, &m_EBO);
+	glDeleteBuffers(m_bufferSize, m_VBO);
+	glDeleteVertexArrays(1, &m_VAO);
+	delete[] m_VBO;
+
+	m_VAO = 0;
+	m_VBO = nullptr;
+	m_EBO = 0;
+	for (int i = 0; i < 4; i++)
+		m_bufferCapacity[i] = 0;
+	m_indexCapacity = 0;
+	TrackMemory();
+}
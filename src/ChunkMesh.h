@@ -0,0 +1,99 @@
+#pragma once
+
+#include "Common.h"
+#include "Math.h"
+
+#include "Blocks.h"
+#include "MeshBuilder.h"
+
+// GPU side of a chunk mesh.
+// Buffers are created on the first upload and updated in place by every upload after it,
+// only growing their storage when a new mesh doesn't fit.
+// Solid and cutout elements are stored as one contiguous range per face direction,
+// translucent elements as a single range kept sorted back to front.
+// Pulled faces have no buffers of their own, they live in slices of the world-wide FaceBuffer,
+// one for the solid and cutout ranges and one for the translucent range so sorting can replace it alone.
+class ChunkMesh
+{
+public:
+	ChunkMesh();
+	~ChunkMesh();
+
+	ChunkMesh(const ChunkMesh &) = delete;
+	ChunkMesh &operator=(const ChunkMesh &) = delete;
+
+	// Mapped FaceBuffer memory for a pulled mesh's solid and cutout faces to be built straight into,
+	// before passing the builder to Upload. nullptr when the format or buffer can't be written directly.
+	unsigned int *MapFaces(const MeshCounts &counts, eMESH_FORMAT format);
+	void Upload(const MeshBuilder &builder);
+	// Draws the directions set in visible, one draw call for all of them
+	// (one per direction for packed faces). Pulled faces expect the FaceBuffer to be bound.
+	// The translucent pass ignores visible and draws its sorted range whole.
+	void Draw(eRENDER_PASS pass, const bool visible[(int)eDIRECTION::DIRECTION_MAX]);
+	void Destroy();
+
+	// Re-sorts the translucent faces back to front for a camera in chunk space,
+	// only once it has moved m_sortThreshold since the last sort.
+	void SortTranslucent(const glm::vec3 &cameraPosition);
+
+	inline eMESH_FORMAT GetFormat() const { return m_format; }
+	inline bool IsEmpty() const { return m_elementCount == 0; }
+	inline int GetElementCount() const { return m_elementCount; }
+	inline bool HasPass(eRENDER_PASS pass) const { return m_passCounts[(int)pass] > 0; }
+	// Bytes reported to the MemoryBudget, given back by Destroy
+	inline size_t GetMemoryUsage() const { return m_trackedMeshData + m_trackedBuffers; }
+
+private:
+	void SetupAttributes();
+
+	struct Slice
+	{
+		int offset = 0;
+		int count = 0;
+	};
+	void ReserveSlice(Slice &slice, int count);
+	void FreeSlice(Slice &slice);
+	// Writes elements at offset (in elements, within the pass's slice for pulled faces)
+	// into wherever this format keeps them
+	void WriteElements(eRENDER_PASS pass, int offset, const unsigned int *elements, int count);
+
+	unsigned int GetElementTarget() const;
+	inline unsigned int GetElementBuffer() const { return m_format == eMESH_FORMAT::PACKED_FACES ? m_VBO[0] : m_EBO; }
+	inline int GetElementsPerFace() const { return IsPackedFormat(m_format) ? 1 : 6; }
+	inline bool HasStorage() const { return m_VAO != 0 || m_slice.count > 0 || m_translucentSlice.count > 0; }
+	// Reports any change in the buffers' and sorting copies' sizes to the MemoryBudget
+	void TrackMemory();
+
+private:
+	eMESH_FORMAT m_format = eMESH_FORMAT::VERTICES;
+
+	int m_bufferSize = 0;
+	unsigned int m_VAO = 0;
+	unsigned int *m_VBO = nullptr;
+	unsigned int m_EBO = 0;
+	size_t m_bufferCapacity[4] = { };
+	size_t m_indexCapacity = 0;
+
+	// FaceBuffer slices for pulled faces
+	Slice m_slice;
+	Slice m_translucentSlice;
+
+	int m_elementCount = 0;
+	int m_passCounts[(int)eRENDER_PASS::PASS_MAX] = { };
+	int m_rangeOffsets[(int)eRENDER_PASS::PASS_MAX][(int)eDIRECTION::DIRECTION_MAX] = { };
+	int m_rangeCounts[(int)eRENDER_PASS::PASS_MAX][(int)eDIRECTION::DIRECTION_MAX] = { };
+
+	// CPU copy of the translucent faces and their centers for sorting
+	std::vector<unsigned int> m_translucentElements;
+	std::vector<glm::vec3> m_translucentCenters;
+	std::vector<unsigned int> m_sortOrder;
+	std::vector<unsigned int> m_sortedElements;
+	glm::vec3 m_lastSortPosition = { 0.0f, 0.0f, 0.0f };
+	bool m_sortDirty = false;
+	const float m_sortThreshold = 2.0f;
+
+	// Bytes last reported to the MemoryBudget
+	size_t m_trackedMeshData = 0;
+	size_t m_trackedBuffers = 0;
+
+};
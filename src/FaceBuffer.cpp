@@ -0,0 +1,189 @@
+#include "FaceBuffer.h"
+
+#include "GLCapabilities.h"
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+FaceBuffer *FaceBuffer::m_instance = nullptr;
+
+FaceBuffer::FaceBuffer(int capacity)
+{
+	spdlog::info("Creating Face Buffer.");
+
+	// Core profile needs a VAO bound to draw, even one without attributes
+	glGenVertexArrays(1, &m_emptyVAO);
+
+	CreateStorage(capacity);
+	m_capacity = capacity;
+	m_freeSlices[0] = capacity;
+
+	m_instance = this;
+}
+FaceBuffer::~FaceBuffer()
+{
+	spdlog::info("Destroying Face Buffer.");
+	for (RetiringSlices &retiring : m_retiringSlices)
+		glDeleteSync((GLsync)retiring.fence);
+	if (m_mapped)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO);
+		glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+	glDeleteBuffers(1, &m_SSBO);
+	glDeleteVertexArrays(1, &m_emptyVAO);
+
+	if (m_instance == this)
+		m_instance = nullptr;
+}
+
+void FaceBuffer::CreateStorage(int capacity)
+{
+	glGenBuffers(1, &m_SSBO);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO);
+	if (GLCapabilities::Get().bufferStorage)
+	{
+		// Coherent, so writes are visible to draws issued after them without flushing
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(unsigned int), nullptr, flags);
+		m_mapped = (unsigned int *)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, capacity * sizeof(unsigned int), flags);
+	}
+	else
+		glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(unsigned int), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+int FaceBuffer::Allocate(int count)
+{
+	// First fit
+	for (auto it = m_freeSlices.begin(); it != m_freeSlices.end(); ++it)
+	{
+		if (it->second < count)
+			continue;
+		int offset = it->first;
+		int remaining = it->second - count;
+		m_freeSlices.erase(it);
+		if (remaining > 0)
+			m_freeSlices[offset + count] = remaining;
+		return offset;
+	}
+
+	Grow(std::max(m_capacity * 2, m_capacity + count));
+	return Allocate(count);
+}
+
+void FaceBuffer::Free(int offset, int count)
+{
+	if (count <= 0)
+		return;
+
+	// Without mapping, GL orders our writes after the draws that read the old contents
+	if (m_mapped)
+		m_pendingSlices.push_back({ offset, count });
+	else
+		Release(offset, count);
+}
+
+void FaceBuffer::Release(int offset, int count)
+{
+	auto it = m_freeSlices.emplace(offset, count).first;
+	// Merge with the following slice
+	auto next = std::next(it);
+	if (next != m_freeSlices.end() && it->first + it->second == next->first)
+	{
+		it->second += next->second;
+		m_freeSlices.erase(next);
+	}
+	// Merge with the preceding slice
+	if (it != m_freeSlices.begin())
+	{
+		auto previous = std::prev(it);
+		if (previous->first + previous->second == it->first)
+		{
+			previous->second += it->second;
+			m_freeSlices.erase(it);
+		}
+	}
+}
+
+void FaceBuffer::Write(int offset, const unsigned int *faces, int count)
+{
+	if (count <= 0)
+		return;
+	if (m_mapped)
+	{
+		std::memcpy(m_mapped + offset, faces, count * sizeof(unsigned int));
+		return;
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset * sizeof(unsigned int), count * sizeof(unsigned int), faces);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+unsigned int *FaceBuffer::Map(int offset)
+{
+	return m_mapped ? m_mapped + offset : nullptr;
+}
+
+void FaceBuffer::Bind()
+{
+	glBindVertexArray(m_emptyVAO);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_SSBO);
+}
+
+void FaceBuffer::EndFrame()
+{
+	if (m_pendingSlices.empty() == false)
+	{
+		m_retiringSlices.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), std::move(m_pendingSlices) });
+		m_pendingSlices.clear();
+	}
+
+	// Fences signal in order, stop at the first one still pending
+	size_t retired = 0;
+	for (; retired < m_retiringSlices.size(); retired++)
+	{
+		GLsync fence = (GLsync)m_retiringSlices[retired].fence;
+		GLenum status = glClientWaitSync(fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			break;
+		glDeleteSync(fence);
+		for (auto &slice : m_retiringSlices[retired].slices)
+			Release(slice.first, slice.second);
+	}
+	m_retiringSlices.erase(m_retiringSlices.begin(), m_retiringSlices.begin() + retired);
+}
+
+void FaceBuffer::Grow(int capacity)
+{
+	spdlog::info("Growing Face Buffer to {0} faces.", capacity);
+
+	// Copy into a bigger buffer so every existing slice keeps its offset.
+	// Deleting the old buffer is deferred by GL until draws still using it are done.
+	unsigned int previousBuffer = m_SSBO;
+	unsigned int *previousMapped = m_mapped;
+	CreateStorage(capacity);
+	glBindBuffer(GL_COPY_READ_BUFFER, previousBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_SSBO);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, m_capacity * sizeof(unsigned int));
+	if (previousMapped)
+		glUnmapBuffer(GL_COPY_READ_BUFFER);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glDeleteBuffers(1, &previousBuffer);
+
+	// Mapped writes aren't ordered with the copy, wait for it so it can't overwrite them.
+	// Growing is rare enough for the stall not to matter.
+	if (m_mapped)
+	{
+		GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		glDeleteSync(fence);
+	}
+
+	int previousCapacity = m_capacity;
+	m_capacity = capacity;
+	Release(previousCapacity, capacity - previousCapacity);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Common.h"
+
+#include <map>
+
+// One world-wide shader storage buffer of packed faces, shared by every chunk mesh.
+// Meshes own slices of it, and the vertex shader pulls faces by gl_VertexID, so drawing
+// any number of chunks needs no vertex attributes and no VAO switches.
+// Requires GL 4.3, see GLCapabilities.
+//
+// With GL 4.4 the buffer is allocated with glBufferStorage and mapped persistently, faces are
+// written straight into GPU visible memory. The GPU may still be reading a slice for a frame or
+// two after it's freed, so freed slices are held back until a fence placed after those frames signals,
+// and a mesh that changes writes a fresh slice instead of overwriting the one being drawn.
+class FaceBuffer
+{
+public:
+	FaceBuffer(int capacity);
+	~FaceBuffer();
+
+	// Returns the first face of a free slice of count faces, growing the buffer if needed.
+	int Allocate(int count);
+	void Free(int offset, int count);
+
+	void Write(int offset, const unsigned int *faces, int count);
+	// Mapped memory of a slice to write faces into directly, nullptr without persistent mapping.
+	unsigned int *Map(int offset);
+
+	// Binds the buffer for drawing
+	void Bind();
+	// Call once all of a frame's draws are issued, fences the slices freed during it
+	// and returns the ones the GPU is done with.
+	void EndFrame();
+
+	inline unsigned int GetBufferID() { return m_SSBO; }
+	inline int GetCapacity() { return m_capacity; }
+	inline bool IsPersistent() { return m_mapped != nullptr; }
+
+	static FaceBuffer *Get() { return m_instance; }
+
+private:
+	void CreateStorage(int capacity);
+	void Release(int offset, int count);
+	void Grow(int capacity);
+
+private:
+	struct RetiringSlices
+	{
+		void *fence;
+		std::vector<std::pair<int, int>> slices;
+	};
+
+	static FaceBuffer *m_instance;
+
+	unsigned int m_SSBO = 0;
+	unsigned int m_emptyVAO = 0;
+	int m_capacity = 0;
+	unsigned int *m_mapped = nullptr;
+
+	// Free slices, offset to count, merged with their neighbours when freed
+	std::map<int, int> m_freeSlices;
+	// Slices freed this frame, and older ones waiting on their fence
+	std::vector<std::pair<int, int>> m_pendingSlices;
+	std::vector<RetiringSlices> m_retiringSlices;
+
+};
@@ -0,0 +1,17 @@
+#include "GLCapabilities.h"
+
+#include <glad/glad.h>
+
+GLCapabilities GLCapabilities::m_capabilities;
+
+void GLCapabilities::Query()
+{
+	m_capabilities.majorVersion = GLVersion.major;
+	m_capabilities.minorVersion = GLVersion.minor;
+	m_capabilities.storageBuffers = GLAD_GL_VERSION_4_3 != 0;
+	m_capabilities.bufferStorage = GLAD_GL_VERSION_4_4 != 0;
+
+	spdlog::info("OpenGL {0}.{1}, Storage Buffers: {2}, Buffer Storage: {3}",
+		m_capabilities.majorVersion, m_capabilities.minorVersion,
+		m_capabilities.storageBuffers, m_capabilities.bufferStorage);
+}
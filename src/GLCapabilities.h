@@ -0,0 +1,21 @@
+#pragma once
+
+#include "Common.h"
+
+// Optional OpenGL features, queried once after the context is loaded.
+// Paths that need them fall back to the GL 3.3 core path when missing.
+struct GLCapabilities
+{
+	int majorVersion = 3;
+	int minorVersion = 3;
+
+	bool storageBuffers = false;	// GL 4.3, vertex pulling from shader storage buffers
+	bool bufferStorage = false;		// GL 4.4, persistently mapped buffers
+
+	static void Query();
+	static const GLCapabilities &Get() { return m_capabilities; }
+
+private:
+	static GLCapabilities m_capabilities;
+
+};
@@ -3,6 +3,7 @@
 #include "Math.h"
 
 #include "Blocks.h"
+#include "GLCapabilities.h"
 
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
@@ -61,6 +62,7 @@ void Game::Init()
 		throw std::runtime_error("Failed to load Glad!");
 	}
 	spdlog::info("Loaded Glad.");
+	GLCapabilities::Query();
 
 	// Setup Input & Callbacks
 	if (glfwRawMouseMotionSupported()) // Set Raw Input
@@ -99,18 +101,40 @@ void Game::Init()
 	glViewport(0, 0, viewportWidth, viewportHeight);
 
 	// Initialize Game
+	m_memoryBudget = std::make_unique<MemoryBudget>(1024ull * 1024 * 1024);
 	m_shaderManager = std::make_unique<ShaderManager>();
+	Shader::SetSharedSource(MeshBuilder::GetShaderSource());
 	m_shaderManager->AddShader("BASIC_SHADER", new Shader("./assets/shaders/v_basic.glsl", "./assets/shaders/f_basic.glsl"));
+	m_shaderManager->AddShader("FACE_SHADER", new Shader("./assets/shaders/v_face.glsl", "./assets/shaders/f_basic.glsl"));
+	// Vertex pulling needs storage buffers, without them the other formats are used
+	Shader *pullShader = nullptr;
+	if (GLCapabilities::Get().storageBuffers)
+	{
+		m_shaderManager->AddShader("PULL_SHADER", new Shader("./assets/shaders/v_pull.glsl", "./assets/shaders/f_basic.glsl"));
+		pullShader = m_shaderManager->GetShader("PULL_SHADER");
+		m_faceBuffer = std::make_unique<FaceBuffer>(1 << 20);
+	}
 
 	m_textureManager = std::make_unique<TextureManager>();
-	m_textureManager->AddTexture("TERRAIN", new Texture("./assets/textures/terrain.png"));
+	// 16px atlas tiles, one texture array layer each
+	m_textureManager->AddTexture("TERRAIN", new Texture("./assets/textures/terrain.png", 16));
+
+	m_meshCache = std::make_unique<MeshCache>(64 * 1024 * 1024);
+	m_meshCache->SetStoreMappedMeshes(m_cachePulledMeshes);
+	// Helps the main thread mesh, so one worker fewer than there are cores
+	m_threadPool = std::make_unique<ThreadPool>(std::max(1, (int)std::thread::hardware_concurrency()) - 1);
 
 	m_camera = std::make_unique<Camera>(90.0f, (float)m_windowWidth / (float)m_windowHeight, 0.1f, 1000.0f);
 	m_camera->position = { -8.0f, 32.0f, 8.0f };
 
-	m_chunk = std::make_unique<ChunkBuilder>(m_shaderManager->GetShader("BASIC_SHADER"), m_textureManager->GetTexture("TERRAIN"));
-	m_chunk->Create();
-	m_chunk->CreateMesh();
+	m_chunkManager = std::make_unique<ChunkManager>(m_shaderManager->GetShader("BASIC_SHADER"), m_shaderManager->GetShader("FACE_SHADER"), pullShader, m_textureManager->GetTexture("TERRAIN"));
+	if (pullShader)
+		m_chunkManager->SetMeshFormat(eMESH_FORMAT::PULLED_FACES);
+	// With v-sync a frame can't be faster than the monitor refreshes
+	GLFWmonitor *monitor = glfwGetPrimaryMonitor();
+	const GLFWvidmode *videoMode = monitor ? glfwGetVideoMode(monitor) : nullptr;
+	if (videoMode && videoMode->refreshRate > 0)
+		m_chunkManager->SetTargetFrameTime(1.0f / (float)videoMode->refreshRate);
 
 	//
 	spdlog::info("Initialized Game.");
@@ -165,12 +189,26 @@ void Game::MainLoop()
 					m_camera->pitch = -89.0f;
 			}
 
+			// Cycle between expanded vertex meshes, instanced packed faces and pulled faces (when supported)
+			if (IsKeyPressed(GLFW_KEY_F2))
+			{
+				static const char *formatNames[] = { "Vertices", "Packed Faces", "Pulled Faces" };
+				int format = ((int)m_chunkManager->GetMeshFormat() + 1) % (int)eMESH_FORMAT::FORMAT_MAX;
+				if (format == (int)eMESH_FORMAT::PULLED_FACES && m_faceBuffer == nullptr)
+					format = (int)eMESH_FORMAT::VERTICES;
+				m_chunkManager->SetMeshFormat((eMESH_FORMAT)format);
+				spdlog::info("Chunk mesh format: {0}", formatNames[format]);
+			}
+
 			// Update Scene
 			m_camera->Update();
 			m_shaderManager->Update(*m_camera);
 
-			m_chunk->Update(m_deltaTime);
-			m_chunk->Draw();
+			m_chunkManager->Update(m_deltaTime, *m_camera);
+			m_chunkManager->Draw();
+
+			if (m_faceBuffer)
+				m_faceBuffer->EndFrame();
 		}
 		glfwSwapBuffers(m_window);
 		PollInput();
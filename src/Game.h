@@ -5,7 +5,11 @@
 #include "Camera.h"
 #include "ShaderManager.h"
 #include "TextureManager.h"
-#include "ChunkBuilder.h"
+#include "ChunkManager.h"
+#include "FaceBuffer.h"
+#include "MemoryBudget.h"
+#include "MeshCache.h"
+#include "ThreadPool.h"
 
 #define MAX_KEYBOARD_INPUT 512
 #define MAX_MOUSE_INPUT 8
@@ -78,6 +82,10 @@ private:
 	const float m_mouseSensitivity = 0.1f;
 	const float m_cameraSpeed = 8.0f;
 
+	// Keep pulled face meshes in the mesh cache, at the cost of building them in CPU memory
+	// instead of straight into the mapped face buffer
+	const bool m_cachePulledMeshes = false;
+
 	std::unique_ptr<int[]> m_keyStates;
 	std::unique_ptr<int[]> m_prevKeyStates;
 	std::unique_ptr<int[]> m_mouseButtonStates;
@@ -93,7 +101,12 @@ private:
 	std::unique_ptr<Camera> m_camera;
 	std::unique_ptr<ShaderManager> m_shaderManager;
 	std::unique_ptr<TextureManager> m_textureManager;
+	// Outlives everything that reports to it
+	std::unique_ptr<MemoryBudget> m_memoryBudget;
+	std::unique_ptr<FaceBuffer> m_faceBuffer;
+	std::unique_ptr<MeshCache> m_meshCache;
+	std::unique_ptr<ThreadPool> m_threadPool;
 
-	std::unique_ptr<ChunkBuilder> m_chunk;
+	std::unique_ptr<ChunkManager> m_chunkManager;
 
 };
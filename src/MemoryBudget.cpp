@@ -0,0 +1,24 @@
+#include "MemoryBudget.h"
+
+MemoryBudget *MemoryBudget::m_instance = nullptr;
+
+MemoryBudget::MemoryBudget(size_t capacity)
+	: m_capacity { capacity }
+{
+	spdlog::info("Created Memory Budget of {} MB.", capacity / (1024 * 1024));
+	m_instance = this;
+}
+MemoryBudget::~MemoryBudget()
+{
+	spdlog::info("Destroyed Memory Budget.");
+	if (m_instance == this)
+		m_instance = nullptr;
+}
+
+size_t MemoryBudget::GetTotal() const
+{
+	size_t total = 0;
+	for (int i = 0; i < (int)eMEMORY::MEMORY_MAX; i++)
+		total += GetUsed((eMEMORY)i);
+	return total;
+}
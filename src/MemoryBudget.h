@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Common.h"
+
+#include <atomic>
+
+// Kinds of memory counted against the MemoryBudget
+enum class eMEMORY
+{
+	BLOCKS = 0,
+	MESH_DATA,
+	GPU_BUFFERS,
+	MEMORY_MAX
+};
+
+// Counts the bytes held by chunk blocks, CPU side mesh data and GL buffers (at the size they were
+// allocated with) against a capacity. Owners report what they allocate and free, from any thread.
+// Nothing is freed here, the ChunkManager gives chunks up while the budget is over capacity.
+class MemoryBudget
+{
+public:
+	MemoryBudget(size_t capacity);
+	~MemoryBudget();
+
+	// Adds bytes to a kind of memory, negative when they are freed
+	inline void Add(eMEMORY kind, int64_t bytes) { m_used[(int)kind] += bytes; }
+	inline size_t GetUsed(eMEMORY kind) const { return (size_t)std::max<int64_t>(m_used[(int)kind], 0); }
+	size_t GetTotal() const;
+
+	inline void SetCapacity(size_t capacity) { m_capacity = capacity; }
+	inline size_t GetCapacity() const { return m_capacity; }
+	inline bool IsOverCapacity() const { return GetTotal() > m_capacity; }
+
+	// Adds to the budget when there is one
+	static inline void Track(eMEMORY kind, int64_t bytes) { if (m_instance) m_instance->Add(kind, bytes); }
+
+	static MemoryBudget *Get() { return m_instance; }
+
+private:
+	static MemoryBudget *m_instance;
+
+	std::atomic<int64_t> m_used[(int)eMEMORY::MEMORY_MAX] = { };
+	std::atomic<size_t> m_capacity;
+
+};
@@ -0,0 +1,302 @@
+#include "MeshBuilder.h"
+
+MeshBuilder::MeshBuilder()
+{ }
+MeshBuilder::~MeshBuilder()
+{ }
+
+int MeshCounts::GetPassTotal(eRENDER_PASS pass) const
+{
+	int total = 0;
+	for (int count : faces[(int)pass])
+		total += count;
+	return total;
+}
+int MeshCounts::GetTotal() const
+{
+	int total = 0;
+	for (int pass = 0; pass < (int)eRENDER_PASS::PASS_MAX; pass++)
+		total += GetPassTotal((eRENDER_PASS)pass);
+	return total;
+}
+size_t MeshCounts::GetByteSize(eMESH_FORMAT format) const
+{
+	// 4 vertices of position, normal and color floats and a layer, plus 6 indices per face
+	const size_t faceSize = IsPackedFormat(format) ? sizeof(unsigned int) : 4 * ((3 + 3 + 4) * sizeof(float) + sizeof(unsigned int)) + 6 * sizeof(unsigned int);
+	return GetTotal() * faceSize;
+}
+
+void MeshBuilder::Begin(const MeshCounts &counts, eMESH_FORMAT format, int scale, unsigned int *output)
+{
+	m_format = format;
+	m_scale = scale;
+	m_direct = output != nullptr;
+	m_vertexCount = 0;
+	m_counts = counts;
+
+	// resize() keeps the capacity, so a reused builder stops allocating once it has seen its largest mesh.
+	const int elementsPerFace = IsPackedFormat(m_format) ? 1 : 6;
+	for (int pass = 0; pass < (int)eRENDER_PASS::PASS_MAX; pass++)
+	{
+		for (int i = 0; i < (int)eDIRECTION::DIRECTION_MAX; i++)
+		{
+			const int elementCount = counts.faces[pass][i] * elementsPerFace;
+			m_cursor[pass][i] = 0;
+			if (m_direct && pass != (int)eRENDER_PASS::TRANSLUCENT)
+			{
+				// Laid out the same way ChunkMesh::Upload writes its ranges
+				m_output[pass][i] = output;
+				output += elementCount;
+				continue;
+			}
+			m_elements[pass][i].resize(elementCount);
+			m_output[pass][i] = m_elements[pass][i].data();
+		}
+	}
+	if (IsPackedFormat(m_format))
+		return;
+
+	for (int pass = 0; pass < (int)eRENDER_PASS::PASS_MAX; pass++)
+	{
+		for (int i = 0; i < (int)eDIRECTION::DIRECTION_MAX; i++)
+		{
+			m_faces[pass][i].resize(counts.faces[pass][i]);
+			m_faceOutput[pass][i] = m_faces[pass][i].data();
+		}
+	}
+
+	// 4 Vertices per face
+	const size_t vertexCount = (size_t)counts.GetTotal() * 4;
+	m_vertices.resize(vertexCount * 3);
+	m_normals.resize(vertexCount * 3);
+	m_layers.resize(vertexCount);
+	m_colors.resize(vertexCount * 4);
+	m_vertexOutput = m_vertices.data();
+	m_normalOutput = m_normals.data();
+	m_layerOutput = m_layers.data();
+	m_colorOutput = m_colors.data();
+}
+
+void MeshBuilder::BeginSlab(MeshBuilder &mesh, const MeshCounts &offset)
+{
+	m_format = mesh.m_format;
+	m_scale = mesh.m_scale;
+	m_direct = mesh.m_direct;
+	// Every face before the slab has 4 vertices
+	m_vertexCount = offset.GetTotal() * 4;
+
+	const int elementsPerFace = IsPackedFormat(m_format) ? 1 : 6;
+	for (int pass = 0; pass < (int)eRENDER_PASS::PASS_MAX; pass++)
+	{
+		for (int i = 0; i < (int)eDIRECTION::DIRECTION_MAX; i++)
+		{
+			m_cursor[pass][i] = 0;
+			m_output[pass][i] = mesh.m_output[pass][i] + offset.faces[pass][i] * elementsPerFace;
+			m_faceOutput[pass][i] = IsPackedFormat(m_format) ? nullptr : mesh.m_faceOutput[pass][i] + offset.faces[pass][i];
+		}
+	}
+	m_vertexOutput = mesh.m_vertexOutput;
+	m_normalOutput = mesh.m_normalOutput;
+	m_layerOutput = mesh.m_layerOutput;
+	m_colorOutput = mesh.m_colorOutput;
+}
+void MeshBuilder::EndSlabs()
+{
+	const int elementsPerFace = IsPackedFormat(m_format) ? 1 : 6;
+	for (int pass = 0; pass < (int)eRENDER_PASS::PASS_MAX; pass++)
+	{
+		for (int i = 0; i < (int)eDIRECTION::DIRECTION_MAX; i++)
+			m_cursor[pass][i] = m_counts.faces[pass][i] * elementsPerFace;
+	}
+	if (IsPackedFormat(m_format) == false)
+		m_vertexCount = m_counts.GetTotal() * 4;
+}
+
+// Quad corners per direction (X-, X+, Y-, Y+, Z-, Z+), in CreateCube's corner order
+static const glm::vec3 s_corners[(int)eDIRECTION::DIRECTION_MAX][4] = {
+	{ { -1, -1, -1 }, { -1, -1,  1 }, { -1,  1,  1 }, { -1,  1, -1 } },
+	{ {  1, -1,  1 }, {  1, -1, -1 }, {  1,  1, -1 }, {  1,  1,  1 } },
+	{ { -1, -1, -1 }, {  1, -1, -1 }, {  1, -1,  1 }, { -1, -1,  1 } },
+	{ { -1,  1,  1 }, {  1,  1,  1 }, {  1,  1, -1 }, { -1,  1, -1 } },
+	{ {  1, -1, -1 }, { -1, -1, -1 }, { -1,  1, -1 }, {  1,  1, -1 } },
+	{ { -1, -1,  1 }, {  1, -1,  1 }, {  1,  1,  1 }, { -1,  1,  1 } },
+};
+static const glm::vec3 s_normals[(int)eDIRECTION::DIRECTION_MAX] = {
+	{ -1, 0, 0 }, { 1, 0, 0 },
+	{ 0, -1, 0 }, { 0, 1, 0 },
+	{ 0, 0, -1 }, { 0, 0, 1 },
+};
+// Two triangles per quad, split along either diagonal
+static const int s_quad[6] = { 0, 1, 2, 0, 2, 3 };
+static const int s_flippedQuad[6] = { 1, 2, 3, 1, 3, 0 };
+// Brightness for 0 to 3 unoccluded neighbours
+static const float s_aoCurve[4] = { 0.45f, 0.65f, 0.85f, 1.0f };
+
+std::string MeshBuilder::GetShaderSource()
+{
+	std::ostringstream source;
+	source.setf(std::ios::fixed);
+	source.precision(2);
+
+	source << "// Generated by MeshBuilder::GetShaderSource from the mesher's face tables\n";
+	source << "const vec3 corners[24] = vec3[24](";
+	for (int i = 0; i < (int)eDIRECTION::DIRECTION_MAX * 4; i++)
+	{
+		const glm::vec3 &corner = s_corners[i / 4][i % 4];
+		source << (i > 0 ? ", " : "") << "vec3(" << corner.x << ", " << corner.y << ", " << corner.z << ")";
+	}
+	source << ");\nconst vec3 normals[6] = vec3[6](";
+	for (int i = 0; i < (int)eDIRECTION::DIRECTION_MAX; i++)
+	{
+		const glm::vec3 &normal = s_normals[i];
+		source << (i > 0 ? ", " : "") << "vec3(" << normal.x << ", " << normal.y << ", " << normal.z << ")";
+	}
+	source << ");\nconst int quad[6] = int[6](";
+	for (int i = 0; i < 6; i++)
+		source << (i > 0 ? ", " : "") << s_quad[i];
+	source << ");\nconst int flippedQuad[6] = int[6](";
+	for (int i = 0; i < 6; i++)
+		source << (i > 0 ? ", " : "") << s_flippedQuad[i];
+	source << ");\nconst float aoCurve[4] = float[4](";
+	for (int i = 0; i < 4; i++)
+		source << (i > 0 ? ", " : "") << s_aoCurve[i];
+	source << ");\n";
+
+	// Tiles the texture once per block from the chunk space position, so merged faces repeat it.
+	// Block faces lie on odd coordinates.
+	source <<
+		"vec2 FaceUV(vec3 position, vec3 normal)\n"
+		"{\n"
+		"\tvec2 uv;\n"
+		"\tif (abs(normal.x) > 0.5)\n"
+		"\t\tuv = vec2(-normal.x * position.z, -position.y);\n"
+		"\telse if (abs(normal.y) > 0.5)\n"
+		"\t\tuv = vec2(position.x, normal.y * position.z);\n"
+		"\telse\n"
+		"\t\tuv = vec2(normal.z * position.x, -position.y);\n"
+		"\treturn (uv + 1.0) * 0.5;\n"
+		"}\n";
+	return source.str();
+}
+
+void MeshBuilder::AddFace(eRENDER_PASS pass, eDIRECTION direction, unsigned int face)
+{
+	if (IsPackedFormat(m_format))
+	{
+		AddPackedFace(pass, direction, face);
+		return;
+	}
+
+	m_faceOutput[(int)pass][(int)direction][m_cursor[(int)pass][(int)direction] / 6] = face;
+
+	glm::ivec3 block = UnpackFacePosition(face);
+	const float scale = (float)m_scale;
+	glm::vec3 center = {
+		(block.x * 2.0f + 1.0f) * scale - 1.0f,
+		(block.y * 2.0f + 1.0f) * scale - 1.0f,
+		(block.z * 2.0f + 1.0f) * scale - 1.0f };
+	const unsigned int layer = (face >> 18) & 63;
+	const glm::vec3 &normal = s_normals[(int)direction];
+
+	int ao[4];
+	unsigned int v[4];
+	for (int corner = 0; corner < 4; corner++)
+	{
+		ao[corner] = (face >> (24 + corner * 2)) & 3;
+		float light = s_aoCurve[ao[corner]];
+		v[corner] = AddVertex(center + s_corners[(int)direction][corner] * scale, normal, layer, light, light, light, 1.0f);
+	}
+
+	// Split the quad along the brighter diagonal so occlusion is interpolated evenly
+	const int *quad = ao[0] + ao[2] >= ao[1] + ao[3] ? s_quad : s_flippedQuad;
+	AddTriangle(pass, direction, v[quad[0]], v[quad[1]], v[quad[2]]); // Tri 1
+	AddTriangle(pass, direction, v[quad[3]], v[quad[4]], v[quad[5]]); // Tri 2
+}
+
+unsigned int MeshBuilder::AddVertex(glm::vec3 point, glm::vec3 normal, unsigned int layer, float r, float g, float b, float a)
+{
+	float *vertex = m_vertexOutput + m_vertexCount * 3;
+	vertex[0] = point.x;
+	vertex[1] = point.y;
+	vertex[2] = point.z;
+
+	float *vertexNormal = m_normalOutput + m_vertexCount * 3;
+	vertexNormal[0] = normal.x;
+	vertexNormal[1] = normal.y;
+	vertexNormal[2] = normal.z;
+
+	m_layerOutput[m_vertexCount] = layer;
+
+	float *color = m_colorOutput + m_vertexCount * 4;
+	color[0] = r;
+	color[1] = g;
+	color[2] = b;
+	color[3] = a;
+
+	return m_vertexCount++;
+}
+void MeshBuilder::AddTriangle(eRENDER_PASS pass, eDIRECTION direction, unsigned int firstIndex, unsigned int secondIndex, unsigned int thirdIndex)
+{
+	int &cursor = m_cursor[(int)pass][(int)direction];
+	unsigned int *elements = m_output[(int)pass][(int)direction] + cursor;
+	elements[0] = firstIndex;
+	elements[1] = secondIndex;
+	elements[2] = thirdIndex;
+	cursor += 3;
+}
+void MeshBuilder::AddPackedFace(eRENDER_PASS pass, eDIRECTION direction, unsigned int face)
+{
+	m_output[(int)pass][(int)direction][m_cursor[(int)pass][(int)direction]++] = face;
+}
+
+size_t MeshBuilder::GetElementCount() const
+{
+	size_t count = 0;
+	for (auto &pass : m_cursor)
+	{
+		for (int elements : pass)
+			count += elements;
+	}
+	return count;
+}
+std::span<const unsigned int> MeshBuilder::GetFaces(eRENDER_PASS pass, eDIRECTION direction) const
+{
+	if (IsPackedFormat(m_format))
+		return GetElements(pass, direction);
+	return { m_faceOutput[(int)pass][(int)direction], (size_t)m_cursor[(int)pass][(int)direction] / 6 };
+}
+
+size_t MeshBuilder::GetByteSize() const
+{
+	size_t size = GetElementCount() * sizeof(unsigned int);
+	if (IsPackedFormat(m_format) == false)
+		size += (size_t)m_vertexCount * ((3 + 3 + 4) * sizeof(float) + sizeof(unsigned int));
+	return size;
+}
+
+unsigned int MeshBuilder::PackFace(glm::ivec3 block, eDIRECTION direction, int textureIndex, int ao1, int ao2, int ao3, int ao4)
+{
+	return (unsigned int)block.x
+		| ((unsigned int)block.y << 5)
+		| ((unsigned int)block.z << 10)
+		| ((unsigned int)direction << 15)
+		| ((unsigned int)textureIndex << 18)
+		| ((unsigned int)ao1 << 24)
+		| ((unsigned int)ao2 << 26)
+		| ((unsigned int)ao3 << 28)
+		| ((unsigned int)ao4 << 30);
+}
+glm::ivec3 MeshBuilder::UnpackFacePosition(unsigned int face)
+{
+	return { (int)(face & 31), (int)((face >> 5) & 31), (int)((face >> 10) & 31) };
+}
+eDIRECTION MeshBuilder::UnpackFaceDirection(unsigned int face)
+{
+	return (eDIRECTION)((face >> 15) & 7);
+}
+
+MeshBuilder &MeshBuilder::GetThreadBuilder()
+{
+	static thread_local MeshBuilder builder;
+	return builder;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "Common.h"
+#include "Math.h"
+
+#include "Blocks.h"
+
+#include <span>
+
+enum class eMESH_FORMAT
+{
+	VERTICES = 0,	// 4 expanded vertices and 6 indices per face
+	PACKED_FACES,	// One packed unsigned int per face, expanded by the vertex shader
+	PULLED_FACES,	// Packed faces in the world-wide FaceBuffer, pulled by gl_VertexID (GL 4.3)
+	FORMAT_MAX
+};
+
+inline bool IsPackedFormat(eMESH_FORMAT format) { return format != eMESH_FORMAT::VERTICES; }
+
+// Exact number of faces a mesh will emit per render pass and face direction,
+// counted before meshing so every output can be sized once.
+struct MeshCounts
+{
+	int faces[(int)eRENDER_PASS::PASS_MAX][(int)eDIRECTION::DIRECTION_MAX] = { };
+
+	int GetPassTotal(eRENDER_PASS pass) const;
+	int GetTotal() const;
+	// Bytes the mesh takes on the GPU in the given format
+	size_t GetByteSize(eMESH_FORMAT format) const;
+};
+
+// CPU side scratch storage for building a mesh.
+// Owns its own vertex counter so any number of meshes can be built, on any thread.
+// Elements (triangle indices, or packed faces) are kept in one bucket per render pass and
+// face direction so passes can be drawn separately and whole directions can be skipped when drawing.
+// Every output is sized exactly from the face counts up front, adding is a plain store.
+class MeshBuilder
+{
+public:
+	MeshBuilder();
+	~MeshBuilder();
+
+	// Resets the counters for a new mesh of exactly counts faces, keeping the allocated capacity.
+	// Scale is the size in blocks of one mesh block, for level of detail meshes.
+	// With an output, solid and cutout packed faces are stored straight into it (a mapped
+	// FaceBuffer slice) pass by pass and direction by direction, instead of into the buckets.
+	void Begin(const MeshCounts &counts, eMESH_FORMAT format, int scale, unsigned int *output = nullptr);
+	// Makes this builder write one slab of mesh's faces, in place, so slabs can be built on separate threads.
+	// Offset is the faces of each bucket that come before the slab, vertices are placed the same way.
+	void BeginSlab(MeshBuilder &mesh, const MeshCounts &offset);
+	// Marks mesh's outputs as filled once every slab begun on it has been built.
+	void EndSlabs();
+
+	// Adds a packed face in the builder's format, expanded into vertices the same way
+	// v_face.glsl does when building vertices. Faces are kept in both cases, see GetFaces.
+	void AddFace(eRENDER_PASS pass, eDIRECTION direction, unsigned int face);
+
+	// The texture layer is all a vertex carries for texturing, UVs come from its position.
+	unsigned int AddVertex(glm::vec3 point, glm::vec3 normal, unsigned int layer, float r, float g, float b, float a);
+	void AddTriangle(eRENDER_PASS pass, eDIRECTION direction, unsigned int firstIndex, unsigned int secondIndex, unsigned int thirdIndex);
+	void AddPackedFace(eRENDER_PASS pass, eDIRECTION direction, unsigned int face);
+
+	inline eMESH_FORMAT GetFormat() const { return m_format; }
+	inline int GetScale() const { return m_scale; }
+
+	inline bool IsDirect() const { return m_direct; }
+
+	inline bool IsEmpty() const { return GetElementCount() == 0; }
+	inline unsigned int GetVertexCount() const { return m_vertexCount; }
+	size_t GetElementCount() const;
+	inline size_t GetFaceCount() const { return GetElementCount() / (IsPackedFormat(m_format) ? 1 : 6); }
+	// Bytes of mesh data built, as it will be uploaded
+	size_t GetByteSize() const;
+
+	inline std::span<const unsigned int> GetElements(eRENDER_PASS pass, eDIRECTION direction) const { return { m_output[(int)pass][(int)direction], (size_t)m_cursor[(int)pass][(int)direction] }; }
+	// Packed faces added with AddFace, whatever the format
+	std::span<const unsigned int> GetFaces(eRENDER_PASS pass, eDIRECTION direction) const;
+	inline const std::vector<float> &GetVertices() const { return m_vertices; }
+	inline const std::vector<float> &GetNormals() const { return m_normals; }
+	inline const std::vector<unsigned int> &GetLayers() const { return m_layers; }
+	inline const std::vector<float> &GetColors() const { return m_colors; }
+
+	// Packed face layout, matching v_face.glsl:
+	// bits 0-14 block position (5 bits per axis), 15-17 direction, 18-23 texture layer,
+	// 24-31 ambient occlusion (2 bits per corner, in CreateCube's corner order)
+	static unsigned int PackFace(glm::ivec3 block, eDIRECTION direction, int textureIndex, int ao1, int ao2, int ao3, int ao4);
+	static glm::ivec3 UnpackFacePosition(unsigned int face);
+	static eDIRECTION UnpackFaceDirection(unsigned int face);
+
+	// GLSL declarations of the face tables (corners, normals, quad splits, occlusion curve)
+	// and FaceUV, so the face shaders expand faces exactly like AddFace. See Shader::SetSharedSource.
+	static std::string GetShaderSource();
+
+	// Builder owned by the calling thread, reused between meshes.
+	static MeshBuilder &GetThreadBuilder();
+
+private:
+	eMESH_FORMAT m_format = eMESH_FORMAT::VERTICES;
+	int m_scale = 1;
+	bool m_direct = false;
+
+	unsigned int m_vertexCount = 0;
+
+	MeshCounts m_counts;
+
+	// Where each bucket's elements (and the packed faces behind vertices) are stored, and how many have been stored so far
+	unsigned int *m_output[(int)eRENDER_PASS::PASS_MAX][(int)eDIRECTION::DIRECTION_MAX] = { };
+	unsigned int *m_faceOutput[(int)eRENDER_PASS::PASS_MAX][(int)eDIRECTION::DIRECTION_MAX] = { };
+	int m_cursor[(int)eRENDER_PASS::PASS_MAX][(int)eDIRECTION::DIRECTION_MAX] = { };
+	// Where vertices are stored, indexed by vertex
+	float *m_vertexOutput = nullptr;
+	float *m_normalOutput = nullptr;
+	unsigned int *m_layerOutput = nullptr;
+	float *m_colorOutput = nullptr;
+
+	std::vector<unsigned int> m_elements[(int)eRENDER_PASS::PASS_MAX][(int)eDIRECTION::DIRECTION_MAX];
+	// Packed faces behind expanded vertices
+	std::vector<unsigned int> m_faces[(int)eRENDER_PASS::PASS_MAX][(int)eDIRECTION::DIRECTION_MAX];
+	std::vector<float> m_vertices;
+	std::vector<float> m_normals;
+	std::vector<unsigned int> m_layers;
+	std::vector<float> m_colors;
+
+};
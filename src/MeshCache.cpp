@@ -0,0 +1,178 @@
+#include "MeshCache.h"
+
+#include "ChunkMesh.h"
+#include "MemoryBudget.h"
+
+MeshCache *MeshCache::m_instance = nullptr;
+
+// Faces are stored per bucket as a varint of the distance from the previous face's position
+// (shifted up a bit, flagging a change of layer and ambient occlusion), followed by those 14 bits
+// when they changed. The direction comes from the bucket. The mesher walks x, then y, then z,
+// so positions keyed as x << 10 | y << 5 | z only ever increase within a bucket.
+static inline unsigned int PositionKey(unsigned int face)
+{
+	return (face & 31) << 10 | ((face >> 5) & 31) << 5 | ((face >> 10) & 31);
+}
+static inline unsigned int KeyToPosition(unsigned int key)
+{
+	return (key >> 10) | ((key >> 5) & 31) << 5 | (key & 31) << 10;
+}
+
+static void WriteVarint(std::vector<unsigned char> &data, unsigned int value)
+{
+	while (value >= 0x80)
+	{
+		data.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	data.push_back((unsigned char)value);
+}
+static unsigned int ReadVarint(const unsigned char *&data)
+{
+	unsigned int value = 0;
+	int shift = 0;
+	while (*data & 0x80)
+	{
+		value |= (unsigned int)(*data++ & 0x7F) << shift;
+		shift += 7;
+	}
+	value |= (unsigned int)*data++ << shift;
+	return value;
+}
+
+MeshCache::MeshCache(size_t capacity)
+	: m_capacity { capacity }
+{
+	spdlog::info("Created Mesh Cache.");
+	m_instance = this;
+}
+MeshCache::~MeshCache()
+{
+	spdlog::info("Destroyed Mesh Cache.");
+	MemoryBudget::Track(eMEMORY::MESH_DATA, -(int64_t)m_size);
+	if (m_instance == this)
+		m_instance = nullptr;
+}
+
+size_t MeshCache::KeyHash::operator()(const MeshCacheKey &key) const
+{
+	size_t hash = std::hash<int>()(key.chunk.x);
+	hash = hash * 31 + std::hash<int>()(key.chunk.y);
+	hash = hash * 31 + std::hash<int>()(key.chunk.z);
+	hash = hash * 31 + std::hash<int>()(key.lod);
+	return hash * 31 + std::hash<int>()(key.section);
+}
+
+size_t MeshCache::GetEntrySize(const Entry &entry)
+{
+	return sizeof(Entry) + sizeof(MeshCacheKey) + entry.data.capacity();
+}
+
+void MeshCache::Store(const MeshCacheKey &key, uint64_t hash, const MeshBuilder &builder)
+{
+	Entry entry;
+	entry.hash = hash;
+	for (int pass = 0; pass < (int)eRENDER_PASS::PASS_MAX; pass++)
+	{
+		for (int i = 0; i < (int)eDIRECTION::DIRECTION_MAX; i++)
+		{
+			std::span<const unsigned int> faces = builder.GetFaces((eRENDER_PASS)pass, (eDIRECTION)i);
+			entry.counts.faces[pass][i] = (int)faces.size();
+
+			unsigned int previousKey = 0;
+			unsigned int previousAttributes = ~0u;
+			for (unsigned int face : faces)
+			{
+				unsigned int key = PositionKey(face);
+				unsigned int attributes = face >> 18;
+				bool changed = attributes != previousAttributes;
+				WriteVarint(entry.data, (key - previousKey) << 1 | (changed ? 1 : 0));
+				if (changed)
+				{
+					entry.data.push_back((unsigned char)attributes);
+					entry.data.push_back((unsigned char)(attributes >> 8));
+				}
+				previousKey = key;
+				previousAttributes = attributes;
+			}
+		}
+	}
+	entry.data.shrink_to_fit();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const size_t size = m_size;
+	auto it = m_entries.find(key);
+	if (it != m_entries.end())
+	{
+		m_size -= GetEntrySize(it->second);
+		m_uses.erase(it->second.use);
+		m_entries.erase(it);
+	}
+	m_uses.push_front(key);
+	entry.use = m_uses.begin();
+	m_size += GetEntrySize(entry);
+	m_entries.emplace(key, std::move(entry));
+	Evict(m_capacity);
+	MemoryBudget::Track(eMEMORY::MESH_DATA, (int64_t)m_size - (int64_t)size);
+}
+
+bool MeshCache::Restore(const MeshCacheKey &key, uint64_t hash, MeshBuilder &builder, eMESH_FORMAT format, int scale, ChunkMesh *target)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_entries.find(key);
+	if (it == m_entries.end() || it->second.hash != hash)
+		return false;
+	Entry &entry = it->second;
+	m_uses.splice(m_uses.begin(), m_uses, entry.use);
+
+	builder.Begin(entry.counts, format, scale, target ? target->MapFaces(entry.counts, format) : nullptr);
+	const unsigned char *data = entry.data.data();
+	for (int pass = 0; pass < (int)eRENDER_PASS::PASS_MAX; pass++)
+	{
+		for (int i = 0; i < (int)eDIRECTION::DIRECTION_MAX; i++)
+		{
+			unsigned int key = 0;
+			unsigned int attributes = 0;
+			for (int face = 0; face < entry.counts.faces[pass][i]; face++)
+			{
+				unsigned int value = ReadVarint(data);
+				key += value >> 1;
+				if (value & 1)
+				{
+					attributes = data[0] | (unsigned int)data[1] << 8;
+					data += 2;
+				}
+				builder.AddFace((eRENDER_PASS)pass, (eDIRECTION)i, KeyToPosition(key) | (unsigned int)i << 15 | attributes << 18);
+			}
+		}
+	}
+	return true;
+}
+
+void MeshCache::SetCapacity(size_t capacity)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const size_t size = m_size;
+	m_capacity = capacity;
+	Evict(m_capacity);
+	MemoryBudget::Track(eMEMORY::MESH_DATA, (int64_t)m_size - (int64_t)size);
+}
+
+void MeshCache::Trim(size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const size_t size = m_size;
+	Evict(m_size > bytes ? m_size - bytes : 0);
+	MemoryBudget::Track(eMEMORY::MESH_DATA, (int64_t)m_size - (int64_t)size);
+}
+
+void MeshCache::Evict(size_t size)
+{
+	while (m_size > size && m_uses.empty() == false)
+	{
+		auto it = m_entries.find(m_uses.back());
+		m_size -= GetEntrySize(it->second);
+		m_entries.erase(it);
+		m_uses.pop_back();
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Common.h"
+#include "Math.h"
+
+#include "MeshBuilder.h"
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+class ChunkMesh;
+
+struct MeshCacheKey
+{
+	glm::ivec3 chunk;
+	int lod;
+	int section;
+
+	bool operator==(const MeshCacheKey &other) const { return chunk == other.chunk && lod == other.lod && section == other.section; }
+};
+
+// CPU side cache of built chunk meshes, kept compressed so that meshes thrown away when
+// chunks leave view or switch detail level can be restored without meshing them again.
+// Entries are validated with a hash of the halo they were built from (see ChunkHalo::Hash),
+// so an entry is never restored for blocks that have changed since.
+// Faces are stored delta coded in the order the mesher emits them, usually 1 to 3 bytes each.
+// Least recently used entries are evicted past the memory capacity.
+class MeshCache
+{
+public:
+	MeshCache(size_t capacity);
+	~MeshCache();
+
+	void Store(const MeshCacheKey &key, uint64_t hash, const MeshBuilder &builder);
+	// Rebuilds a stored mesh into builder in the given format, returns false when there is none for hash.
+	// Given the mesh it will be uploaded to, pulled faces are restored straight into it.
+	bool Restore(const MeshCacheKey &key, uint64_t hash, MeshBuilder &builder, eMESH_FORMAT format, int scale, ChunkMesh *target = nullptr);
+
+	void SetCapacity(size_t capacity);
+	// Evicts the least recently used entries until bytes are freed or the cache is empty.
+	// The capacity is kept, so the cache fills up again as meshes are stored.
+	void Trim(size_t bytes);
+	inline size_t GetCapacity() { return m_capacity; }
+	inline size_t GetSize() { return m_size; }
+
+	// Whether meshes that could be built straight into mapped GPU memory are stored anyway.
+	// Storing one means building it in CPU memory and copying it up, as mapped memory is far too
+	// slow to read back. Off by default, those meshes are built in place and meshed again when needed.
+	inline void SetStoreMappedMeshes(bool store) { m_storeMappedMeshes = store; }
+	inline bool IsStoringMappedMeshes() { return m_storeMappedMeshes; }
+
+	static MeshCache *Get() { return m_instance; }
+
+private:
+	struct KeyHash
+	{
+		size_t operator()(const MeshCacheKey &key) const;
+	};
+	struct Entry
+	{
+		uint64_t hash;
+		MeshCounts counts;
+		std::vector<unsigned char> data;
+		std::list<MeshCacheKey>::iterator use;
+	};
+
+	// Least recently used entries first until the cache fits in size
+	void Evict(size_t size);
+	static size_t GetEntrySize(const Entry &entry);
+
+private:
+	static MeshCache *m_instance;
+
+	std::mutex m_mutex;
+	size_t m_capacity;
+	size_t m_size = 0;
+	bool m_storeMappedMeshes = false;
+
+	std::unordered_map<MeshCacheKey, Entry, KeyHash> m_entries;
+	// Most recently used first
+	std::list<MeshCacheKey> m_uses;
+
+};
@@ -5,6 +5,8 @@
 #include <filesystem>
 #include <fstream>
 
+std::string Shader::m_sharedSource;
+
 Shader::Shader()
 { }
 Shader::Shader(const char *vertexPath, const char *fragPath)
@@ -44,8 +46,8 @@ void Shader::Create(const char *vertexPath, const char *fragPath)
 		vertexFile.close();
 		fragFile.close();
 
-		vertexCode = vStream.str();
-		fragCode = fStream.str();
+		vertexCode = InsertSharedSource(vStream.str());
+		fragCode = InsertSharedSource(fStream.str());
 	}
 	catch (std::ifstream::failure e)
 	{
@@ -102,6 +104,23 @@ void Shader::Use()
 	glUseProgram(m_shaderID);
 }
 
+void Shader::SetSharedSource(const std::string &source)
+{
+	m_sharedSource = source;
+}
+
+std::string Shader::InsertSharedSource(const std::string &code)
+{
+	if (m_sharedSource.empty())
+		return code;
+
+	// #version has to stay first, #line keeps compile errors pointing at the file's own lines
+	size_t versionEnd = code.find('\n', code.find("#version"));
+	if (versionEnd == std::string::npos)
+		return code;
+	return code.substr(0, versionEnd + 1) + m_sharedSource + "#line 2\n" + code.substr(versionEnd + 1);
+}
+
 void Shader::SetBoolean(const std::string &name, const bool &value) const
 {
 	glUniform1i(glGetUniformLocation(m_shaderID, name.c_str()), (int)value);
@@ -14,6 +14,9 @@ public:
 
 	void Use();
 
+	// Source inserted after the #version line of every shader created afterwards.
+	static void SetSharedSource(const std::string &source);
+
 	void SetBoolean(const std::string &name, const bool &value) const;
 	void SetInteger(const std::string &name, const int &value) const;
 	void SetFloat(const std::string &name, const float &value) const;
@@ -25,6 +28,10 @@ public:
 	const inline unsigned int &GetShaderID() { return m_shaderID; }
 
 private:
+	static std::string InsertSharedSource(const std::string &code);
+
 	unsigned int m_shaderID;
 
+	static std::string m_sharedSource;
+
 };
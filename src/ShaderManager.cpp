@@ -27,8 +27,6 @@ void ShaderManager::Update(const Camera &camera) const
 		shader->Use();
 		shader->SetMatrix4("view", camera.view);
 		shader->SetMatrix4("proj", camera.proj);
-
-		shader->SetVector3("cameraPos", camera.position);
 	}
 }
 
@@ -29,6 +29,7 @@ void Texture::Create(const char *imagePath)
 	m_textureHeight = height;
 	
 	spdlog::info("Generating Texture.");
+	m_target = GL_TEXTURE_2D;
 	glGenTextures(1, &m_textureID);
 	glBindTexture(GL_TEXTURE_2D, m_textureID);
 
@@ -39,7 +40,8 @@ void Texture::Create(const char *imagePath)
 
 	if (data)
 	{
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+		GLenum format = nrChannels == 4 ? GL_RGBA : GL_RGB;
+		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
 		glGenerateMipmap(GL_TEXTURE_2D);
 	}
 	else
@@ -49,7 +51,60 @@ void Texture::Create(const char *imagePath)
 	stbi_image_free(data);
 }
 
+void Texture::CreateArray(const char *imagePath, int tileSize)
+{
+	spdlog::info("Creating Texture Array.");
+
+	std::string imageFullPath = std::filesystem::absolute(imagePath).string();
+
+	int width, height, nrChannels;
+
+	spdlog::info("Loading Texture Image @[{0}]", imageFullPath.c_str());
+	unsigned char *data = stbi_load(imagePath, &width, &height, &nrChannels, 4);
+
+	m_textureWidth = tileSize;
+	m_textureHeight = tileSize;
+
+	spdlog::info("Generating Texture Array.");
+	m_target = GL_TEXTURE_2D_ARRAY;
+	glGenTextures(1, &m_textureID);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_textureID);
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	if (data)
+	{
+		const int columns = width / tileSize;
+		const int rows = height / tileSize;
+		m_layerCount = columns * rows;
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, tileSize, tileSize, m_layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+		// Each tile is read straight out of the atlas rows
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+		for (int layer = 0; layer < m_layerCount; layer++)
+		{
+			glPixelStorei(GL_UNPACK_SKIP_PIXELS, (layer % columns) * tileSize);
+			glPixelStorei(GL_UNPACK_SKIP_ROWS, (layer / columns) * tileSize);
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, tileSize, tileSize, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
+		}
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+		glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+
+		// Mipmaps of an array are generated per layer
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	}
+	else
+	{
+		spdlog::error("Failed to load texture @[{0}]", imageFullPath.c_str());
+	}
+	stbi_image_free(data);
+}
+
 void Texture::Use()
 {
-	glBindTexture(GL_TEXTURE_2D, m_textureID);
+	glBindTexture(m_target, m_textureID);
 }
@@ -7,18 +7,25 @@ class Texture
 public:
 	Texture() { }
 	Texture(const char *imagePath) { Create(imagePath); }
+	Texture(const char *imagePath, int tileSize) { CreateArray(imagePath, tileSize); }
 	~Texture();
 
 	void Create(const char *imagePath);
+	// Slices an atlas of tileSize tiles into a texture array, one layer per tile in reading order,
+	// each mipmapped on its own so tiles never bleed into each other.
+	void CreateArray(const char *imagePath, int tileSize);
 	void Use();
 
 	const inline int GetWidth() { return m_textureWidth; }
 	const inline int GetHeight() { return m_textureHeight; }
+	const inline int GetLayerCount() { return m_layerCount; }
 
 	const inline unsigned int &GetTextureID() { return m_textureID; }
 
 private:
 	unsigned int m_textureID;
+	unsigned int m_target = 0;
 	int m_textureWidth, m_textureHeight;
+	int m_layerCount = 1;
 
 };
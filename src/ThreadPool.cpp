@@ -0,0 +1,89 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool *ThreadPool::m_instance = nullptr;
+
+ThreadPool::ThreadPool(int threadCount)
+{
+	spdlog::info("Created Thread Pool with {} workers.", threadCount);
+	m_instance = this;
+
+	for (int i = 0; i < threadCount; i++)
+		m_threads.emplace_back(&ThreadPool::Work, this);
+}
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+	for (std::thread &thread : m_threads)
+		thread.join();
+
+	spdlog::info("Destroyed Thread Pool.");
+	if (m_instance == this)
+		m_instance = nullptr;
+}
+
+void ThreadPool::Run(int count, JobFunction job, const void *context)
+{
+	if (count <= 0)
+		return;
+	if (m_threads.empty() || count == 1)
+	{
+		for (int i = 0; i < count; i++)
+			job(context, i);
+		return;
+	}
+
+	Batch batch;
+	batch.job = job;
+	batch.context = context;
+	batch.count = count;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_batches.push_back(&batch);
+	}
+	m_wake.notify_all();
+
+	RunJobs(batch);
+
+	// Every job has been claimed, wait for the workers still running theirs
+	std::unique_lock<std::mutex> lock(m_mutex);
+	auto queued = std::find(m_batches.begin(), m_batches.end(), &batch);
+	if (queued != m_batches.end())
+		m_batches.erase(queued);
+	m_finished.wait(lock, [&batch] { return batch.workers == 0; });
+}
+
+void ThreadPool::RunJobs(Batch &batch)
+{
+	for (int i = batch.next++; i < batch.count; i = batch.next++)
+		batch.job(batch.context, i);
+}
+
+void ThreadPool::Work()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_wake.wait(lock, [this] { return m_stopping || m_batches.empty() == false; });
+		if (m_stopping)
+			return;
+
+		Batch *batch = m_batches.front();
+		batch->workers++;
+		lock.unlock();
+		RunJobs(*batch);
+		lock.lock();
+
+		// Nothing left to claim, stop handing the batch out
+		auto queued = std::find(m_batches.begin(), m_batches.end(), batch);
+		if (queued != m_batches.end())
+			m_batches.erase(queued);
+		if (--batch->workers == 0)
+			m_finished.notify_all();
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Common.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Fixed set of worker threads for splitting one piece of work into parallel jobs.
+// The calling thread works on its own jobs too, so a parallel call made from inside a job
+// (or with every worker busy) still finishes instead of waiting on a queue.
+class ThreadPool
+{
+public:
+	ThreadPool(int threadCount);
+	~ThreadPool();
+
+	// Runs job(0) to job(count - 1) across the workers and the calling thread, returning once all have run.
+	// The job is called through a plain pointer, so capturing lambdas don't allocate.
+	template<typename Job>
+	void ParallelFor(int count, const Job &job)
+	{
+		Run(count, [](const void *context, int index) { (*(const Job *)context)(index); }, &job);
+	}
+
+	inline int GetThreadCount() const { return (int)m_threads.size(); }
+
+	static ThreadPool *Get() { return m_instance; }
+
+private:
+	typedef void (*JobFunction)(const void *context, int index);
+
+	struct Batch
+	{
+		JobFunction job;
+		const void *context;
+		int count;
+		std::atomic<int> next = 0;
+		// Workers still inside the batch, guarded by the pool's mutex
+		int workers = 0;
+	};
+
+	void Run(int count, JobFunction job, const void *context);
+	void Work();
+	static void RunJobs(Batch &batch);
+
+private:
+	static ThreadPool *m_instance;
+
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_finished;
+	// Batches with jobs left to claim, oldest first
+	std::deque<Batch *> m_batches;
+	bool m_stopping = false;
+
+};